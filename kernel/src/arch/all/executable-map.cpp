@@ -0,0 +1,32 @@
+#include "executable-map.hpp"
+#include <anarch/critical>
+#include <ansa/atomic>
+
+namespace Alux {
+
+namespace {
+
+// there are no global constructors, so Initialize() allocates this; every
+// CPU's fault path reads it while root may change it at any time
+ansa::Atomic<int> * faultAroundPages;
+
+}
+
+void ExecutableMap::Initialize() {
+  AssertNoncritical();
+  faultAroundPages = new ansa::Atomic<int>(DefaultFaultAroundPages);
+  assert(faultAroundPages != NULL);
+}
+
+bool ExecutableMap::SetFaultAroundPages(int pages) {
+  if (pages < 1 || pages > MaxFaultAroundPages) return false;
+  if (pages & (pages - 1)) return false;
+  *faultAroundPages = pages;
+  return true;
+}
+
+int ExecutableMap::GetFaultAroundPages() {
+  return *faultAroundPages;
+}
+
+}
@@ -47,6 +47,31 @@ public:
    */
   virtual void Delete() = 0;
   
+  /**
+   * Create the shared fault-around setting. Call this once, after the heap
+   * has been initialized and before any program runs.
+   * @noncritical
+   */
+  static void Initialize();
+  
+  /**
+   * Set how many pages are mapped at once when a program faults on a page
+   * which has been split off from a large page. The pages are taken from an
+   * aligned window around the fault. [pages] must be a power of two from 1 to
+   * [MaxFaultAroundPages]; returns `false` if it is not.
+   * @ambicritical
+   */
+  static bool SetFaultAroundPages(int pages);
+  
+  /**
+   * Returns the number of pages set with [SetFaultAroundPages].
+   * @ambicritical
+   */
+  static int GetFaultAroundPages();
+  
+  static const int DefaultFaultAroundPages = 0x10;
+  static const int MaxFaultAroundPages = 0x200;
+  
   /**
    * Returns the user map that this executable map controls.
    */
@@ -0,0 +1,51 @@
+#include "boot-arguments.hpp"
+
+namespace Alux {
+
+namespace x64 {
+
+namespace {
+
+const uint32_t CommandLineFlag = 4;
+
+}
+
+BootArguments::BootArguments(void * mbootPtr) : commandLine(NULL) {
+  // the structure and the string it points to are identity mapped at boot
+  uint32_t * info = (uint32_t *)mbootPtr;
+  if (info[0] & CommandLineFlag) {
+    commandLine = (const char *)(uint64_t)info[4];
+  }
+}
+
+bool BootArguments::GetInteger(const char * name, uint64_t & result) const {
+  if (!commandLine) return false;
+  const char * arg = commandLine;
+  while (*arg) {
+    while (*arg == ' ') ++arg;
+    const char * str = arg;
+    const char * match = name;
+    while (*match && *str == *match) {
+      ++str;
+      ++match;
+    }
+    if (!*match && *str == '=') {
+      ++str;
+      if (*str < '0' || *str > '9') return false;
+      uint64_t value = 0;
+      while (*str >= '0' && *str <= '9') {
+        value = value * 10 + (uint64_t)(*str - '0');
+        ++str;
+      }
+      if (*str && *str != ' ') return false;
+      result = value;
+      return true;
+    }
+    while (*arg && *arg != ' ') ++arg;
+  }
+  return false;
+}
+
+}
+
+}
@@ -0,0 +1,35 @@
+#ifndef __ALUX_X64_BOOT_ARGUMENTS_HPP__
+#define __ALUX_X64_BOOT_ARGUMENTS_HPP__
+
+#include <anarch/stddef>
+#include <anarch/stdint>
+
+namespace Alux {
+
+namespace x64 {
+
+/**
+ * The command line that the bootloader passed in the Multiboot information
+ * structure. Arguments are separated by spaces and have the form
+ * `name=value`; anything else on the line is ignored.
+ */
+class BootArguments {
+public:
+  BootArguments(void * mbootPtr);
+  
+  /**
+   * Read the decimal value of the argument [name]. Returns `false`, leaving
+   * [result] alone, if there is no such argument or its value is not a
+   * number.
+   */
+  bool GetInteger(const char * name, uint64_t & result) const;
+  
+private:
+  const char * commandLine;
+};
+
+}
+
+}
+
+#endif
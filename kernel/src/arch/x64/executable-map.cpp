@@ -1,5 +1,7 @@
 #include "executable-map.hpp"
 #include "executable.hpp"
+#include "../../memory/page-cache.hpp"
+#include <anarch/api/global-map>
 #include <anarch/api/domain>
 #include <anarch/api/panic>
 #include <anarch/critical>
@@ -31,11 +33,17 @@ bool ExecutableMap::HandlePageFault(VirtAddr addr, bool write) {
     return false;
   }
 
-  int idx = (int)((addr - StartAddr) / 0x200000);
+  int idx = (int)((addr - StartAddr) / SectorSize);
   assert(idx >= 0 && idx < sectorCount);
   Sector & sector = sectors[idx];
   addr &= ~(PhysAddr)0xfff; // page align it
-  if (write) {
+  if (sector.mode == 0) {
+    executable.NoteSectorUsed(idx);
+  }
+  if (sector.mode == 3) {
+    // another thread faulted on the sector while it was being promoted
+    return true;
+  } else if (write) {
     HandleWriteFault(sector, addr);
   } else {
     HandleReadFault(sector, addr);
@@ -51,30 +59,42 @@ void ExecutableMap::Delete() {
 
 ExecutableMap::ExecutableMap(Executable & e, anarch::UserMap & m)
   : Alux::ExecutableMap(m), executable(e) {
-  sectorCount = executable.GetLength() / 0x200000;
+  sectorCount = executable.GetLength() / SectorSize;
   if (!sectorCount) return;
   
   sectors = new Sector[sectorCount];
   assert(sectors != NULL);
   for (int i = 0; i < sectorCount; ++i) {
-    size_t offset = (size_t)i * 0x200000;
+    size_t offset = (size_t)i * SectorSize;
     sectors[i].virtualAddr = StartAddr + offset;
     sectors[i].readOnlyAddr = executable.GetMemory() + offset;
   }
   
-  anarch::UserMap::Size size(0x200000, sectorCount);
+  anarch::UserMap::Size size(SectorSize, sectorCount);
   GetMap().ReserveAt(StartAddr, size);
+  
+  // the image is shared, so sectors which an earlier task used can be
+  // mapped read-only now instead of one fault at a time
+  for (int i = 0; i < sectorCount; ++i) {
+    if (executable.IsSectorUsed(i)) MapROLargePage(sectors[i]);
+  }
 }
 
 ExecutableMap::~ExecutableMap() {
   for (int i = 0; i < sectorCount; ++i) {
+    if (sectors[i].mode == 3) {
+      anarch::Domain::GetCurrent().FreePhys(sectors[i].privateAddr);
+      continue;
+    }
     if (sectors[i].mode != 2) continue;
-    // free each writable region of physical memory
-    for (int j = 0; j < 0x200; ++j) {
+    // free each writable page of physical memory at once, packing the list
+    // of writables down to the pages that were actually copied
+    int count = 0;
+    for (int j = 0; j < SectorPageCount; ++j) {
       PhysAddr writable = sectors[i].writables[j];
-      if (!writable) continue;
-      anarch::Domain::GetCurrent().FreePhys(writable);
+      if (writable) sectors[i].writables[count++] = writable;
     }
+    PageCache::FreeBatch(sectors[i].writables, count);
     // free the writables list
     delete[] sectors[i].writables;
   }
@@ -88,7 +108,7 @@ void ExecutableMap::HandleReadFault(Sector & s, VirtAddr pageAddr) {
   if (s.mode == 0) {
     MapROLargePage(s);
   } else if (s.mode == 2) {
-    MapROSmallPage(s, pageAddr);
+    MapROSmallPages(s, pageAddr);
   }
 }
 
@@ -96,7 +116,10 @@ void ExecutableMap::HandleWriteFault(Sector & sector, VirtAddr pageAddr) {
   if (sector.mode != 2) {
     SwitchToWritable(sector);
   }
-  MapWritablePage(sector, pageAddr);
+  MapWritablePages(sector, pageAddr);
+  if (sector.writableCount >= PromoteCount) {
+    PromoteSector(sector);
+  }
 }
 
 void ExecutableMap::MapROLargePage(Sector & sector) {
@@ -104,48 +127,181 @@ void ExecutableMap::MapROLargePage(Sector & sector) {
   attrs.writable = false;
   
   GetMap().MapAt(sector.virtualAddr, sector.readOnlyAddr,
-                 anarch::UserMap::Size(0x200000, 1), attrs);
+                 anarch::UserMap::Size(SectorSize, 1), attrs);
   
   sector.mode = 1;
 }
 
-void ExecutableMap::MapROSmallPage(Sector & sector, VirtAddr pageAddr) {
-  PhysSize subIndex = pageAddr % 0x200000;
-  
+void ExecutableMap::MapROSmallPages(Sector & sector, VirtAddr pageAddr) {
   anarch::UserMap::Attributes attrs;
   attrs.writable = false;
-
-  GetMap().MapAt(sector.virtualAddr + subIndex, sector.readOnlyAddr + subIndex,
-                 anarch::UserMap::Size(0x1000, 1), attrs);
+  
+  // the image is contiguous, so each run of unmapped pages in the window
+  // takes a single call
+  int first, end;
+  GetWindow(sector, pageAddr, first, end);
+  int page = first;
+  while (page < end) {
+    if (sector.writables[page] || sector.IsReadOnly(page)) {
+      ++page;
+      continue;
+    }
+    int runEnd = page + 1;
+    while (runEnd < end && !sector.writables[runEnd] &&
+           !sector.IsReadOnly(runEnd)) {
+      ++runEnd;
+    }
+    PhysSize offset = (PhysSize)page * 0x1000;
+    GetMap().MapAt(sector.virtualAddr + offset, sector.readOnlyAddr + offset,
+                   anarch::UserMap::Size(0x1000, runEnd - page), attrs);
+    for (int i = page; i < runEnd; ++i) {
+      sector.SetReadOnly(i, true);
+    }
+    page = runEnd;
+  }
 }
 
 void ExecutableMap::SwitchToWritable(Sector & sector) {
-  anarch::UserMap::Size bigSize(0x200000, 1);
+  anarch::UserMap::Size bigSize(SectorSize, 1);
   if (sector.mode == 1) {
     GetMap().UnmapAndReserve(sector.virtualAddr, bigSize);
   }
   GetMap().Rereserve(sector.virtualAddr, bigSize, 0x1000);
   
-  sector.writables = new PhysAddr[0x200]();
+  sector.writables = new PhysAddr[SectorPageCount]();
   sector.mode = 2;
 }
 
-void ExecutableMap::MapWritablePage(Sector & sector, VirtAddr pageAddr) {
-  PhysAddr page;
-  if (!anarch::Domain::GetCurrent().AllocPhys(page, 0x1000, 0x1000)) {
-    anarch::Panic("ExecutableMap::MapWritablePage() - alloc failed");
+void ExecutableMap::MapWritablePages(Sector & sector, VirtAddr pageAddr) {
+  int faultPage = (int)((pageAddr % SectorSize) / 0x1000);
+  int first, end;
+  GetWindow(sector, pageAddr, first, end);
+  
+  anarch::UserMap::Attributes attrs;
+  for (int i = first; i < end; ++i) {
+    if (sector.writables[i]) continue;
+    PhysAddr page;
+    if (!PageCache::Alloc(page)) {
+      // the neighbours are only worth copying while memory is plentiful
+      if (i != faultPage) continue;
+      anarch::Panic("ExecutableMap::MapWritablePages() - alloc failed");
+    }
+    
+    VirtAddr addr = sector.virtualAddr + (VirtAddr)i * 0x1000;
+    anarch::UserMap::Size size(0x1000, 1);
+    if (sector.IsReadOnly(i)) {
+      GetMap().UnmapAndReserve(addr, size);
+      sector.SetReadOnly(i, false);
+    }
+    sector.writables[i] = page;
+    ++sector.writableCount;
+    GetMap().MapAt(addr, page, size, attrs);
+    
+    // copy the read-only memory into the writable memory
+    uint8_t * virtualSource = (uint8_t *)executable.GetReadableMemory() +
+      (addr - StartAddr);
+    ansa::Memcpy((void *)addr, (void *)virtualSource, 0x1000);
   }
+}
 
-  int pageIdx = (int)((pageAddr % 0x200000) / 0x1000);
-  sector.writables[pageIdx] = page;
-
-  anarch::UserMap::Attributes attrs;
-  GetMap().MapAt(pageAddr, page, anarch::UserMap::Size(0x1000, 1), attrs);
+void ExecutableMap::PromoteSector(Sector & sector) {
+  anarch::Domain & domain = anarch::Domain::GetCurrent();
+  anarch::GlobalMap & global = anarch::GlobalMap::GetGlobal();
+  anarch::UserMap::Size smallPages(0x1000, SectorPageCount);
   
-  // copy the read-only memory into the writable memory
-  uint8_t * virtualSource = (uint8_t *)executable.GetReadableMemory() +
-    (pageAddr - StartAddr);
-  ansa::Memcpy((void *)pageAddr, (void *)virtualSource, 0x1000);
+  PhysAddr privateAddr;
+  if (!domain.AllocPhys(privateAddr, SectorSize, SectorSize)) return;
+  anarch::UserMap::Attributes windowAttrs;
+  windowAttrs.executable = false;
+  VirtAddr window;
+  if (!global.Map(window, privateAddr, smallPages, windowAttrs)) {
+    domain.FreePhys(privateAddr);
+    return;
+  }
+  
+  // the small pages are unmapped first so that the task's other threads
+  // fault and wait for us rather than writing to pages we have copied
+  UnmapSmallPages(sector);
+  bool copied = true;
+  const char * image = executable.GetReadableMemory() +
+    (sector.virtualAddr - StartAddr);
+  for (int i = 0; i < SectorPageCount && copied; ++i) {
+    void * dest = (void *)(window + (VirtAddr)i * 0x1000);
+    if (sector.writables[i]) {
+      copied = PageCache::Copy(dest, sector.writables[i]);
+    } else {
+      ansa::Memcpy(dest, (void *)(image + i * 0x1000), 0x1000);
+    }
+  }
+  global.Unmap(window, smallPages);
+  if (!copied) {
+    RemapSmallPages(sector);
+    domain.FreePhys(privateAddr);
+    return;
+  }
+  
+  int count = 0;
+  for (int i = 0; i < SectorPageCount; ++i) {
+    PhysAddr writable = sector.writables[i];
+    if (writable) sector.writables[count++] = writable;
+  }
+  PageCache::FreeBatch(sector.writables, count);
+  delete[] sector.writables;
+  sector.writables = NULL;
+  sector.writableCount = 0;
+  for (int i = 0; i < SectorPageCount / 64; ++i) {
+    sector.readOnly[i] = 0;
+  }
+  
+  anarch::UserMap::Attributes attrs;
+  GetMap().Rereserve(sector.virtualAddr, smallPages, SectorSize);
+  GetMap().MapAt(sector.virtualAddr, privateAddr,
+                 anarch::UserMap::Size(SectorSize, 1), attrs);
+  sector.privateAddr = privateAddr;
+  sector.mode = 3;
+}
+
+void ExecutableMap::UnmapSmallPages(Sector & sector) {
+  // unmap runs of mapped pages, leaving them reserved
+  int page = 0;
+  while (page < SectorPageCount) {
+    if (!sector.writables[page] && !sector.IsReadOnly(page)) {
+      ++page;
+      continue;
+    }
+    int runEnd = page + 1;
+    while (runEnd < SectorPageCount &&
+           (sector.writables[runEnd] || sector.IsReadOnly(runEnd))) {
+      ++runEnd;
+    }
+    GetMap().UnmapAndReserve(sector.virtualAddr + (VirtAddr)page * 0x1000,
+                             anarch::UserMap::Size(0x1000, runEnd - page));
+    page = runEnd;
+  }
+}
+
+void ExecutableMap::RemapSmallPages(Sector & sector) {
+  anarch::UserMap::Attributes roAttrs;
+  roAttrs.writable = false;
+  anarch::UserMap::Attributes rwAttrs;
+  anarch::UserMap::Size size(0x1000, 1);
+  for (int i = 0; i < SectorPageCount; ++i) {
+    VirtAddr addr = sector.virtualAddr + (VirtAddr)i * 0x1000;
+    if (sector.writables[i]) {
+      GetMap().MapAt(addr, sector.writables[i], size, rwAttrs);
+    } else if (sector.IsReadOnly(i)) {
+      GetMap().MapAt(addr, sector.readOnlyAddr + (PhysSize)i * 0x1000, size,
+                     roAttrs);
+    }
+  }
+}
+
+void ExecutableMap::GetWindow(Sector & sector, VirtAddr pageAddr,
+                              int & first, int & end) {
+  int window = Alux::ExecutableMap::GetFaultAroundPages();
+  int page = (int)((pageAddr - sector.virtualAddr) / 0x1000);
+  first = page & ~(window - 1);
+  end = first + window;
 }
 
 }
@@ -27,20 +27,47 @@ private:
   
   Executable & executable;
   
+  static const size_t SectorSize = 0x200000;
+  static const int SectorPageCount = 0x200;
+  
+  // a sector with this many private pages gets a private large page instead
+  static const int PromoteCount = SectorPageCount / 2;
+  
   struct Sector {
-    int mode = 0; // 0 = unmapped, 1 = read, 2 = read/write
+    int mode = 0; // 0 = unmapped, 1 = read, 2 = read/write, 3 = private
     PhysAddr * writables = NULL;
+    int writableCount = 0;
+    uint64_t readOnly[SectorPageCount / 64] = {}; // pages mapped in mode 2
     VirtAddr virtualAddr;
     PhysAddr readOnlyAddr;
+    PhysAddr privateAddr = 0; // the sector's own copy in mode 3
+    
+    inline bool IsReadOnly(int page) {
+      return (readOnly[page / 64] & ((uint64_t)1 << (page % 64))) != 0;
+    }
+    
+    inline void SetReadOnly(int page, bool flag) {
+      uint64_t bit = (uint64_t)1 << (page % 64);
+      if (flag) {
+        readOnly[page / 64] |= bit;
+      } else {
+        readOnly[page / 64] &= ~bit;
+      }
+    }
   };
   
   void HandleReadFault(Sector &, VirtAddr pageAddr);
   void HandleWriteFault(Sector &, VirtAddr pageAddr);
   
   void MapROLargePage(Sector &);
-  void MapROSmallPage(Sector &, VirtAddr pageAddr);
+  void MapROSmallPages(Sector &, VirtAddr pageAddr);
   void SwitchToWritable(Sector &);
-  void MapWritablePage(Sector &, VirtAddr pageAddr);
+  void MapWritablePages(Sector &, VirtAddr pageAddr);
+  void PromoteSector(Sector &);
+  void UnmapSmallPages(Sector &);
+  void RemapSmallPages(Sector &);
+  
+  static void GetWindow(Sector &, VirtAddr pageAddr, int & first, int & end);
   
   anarch::NoncriticalLock lock;
   int sectorCount;
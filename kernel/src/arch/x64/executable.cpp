@@ -1,5 +1,6 @@
 #include "executable.hpp"
 #include <anarch/assert>
+#include <anarch/critical>
 
 namespace Alux {
 
@@ -8,12 +9,27 @@ namespace x64 {
 Executable::Executable(PhysAddr m, size_t l) : memory(m), length(l) {
   assert(l % 0x200000 == 0);
   assert(m % 0x200000 == 0);
+  size_t sectorCount = l / 0x200000;
+  usedSectors = new uint64_t[(sectorCount + 63) / 64]();
+  assert(usedSectors != NULL);
 }
 
 ExecutableMap & Executable::GenerateMap(anarch::UserMap & m) {
   return ExecutableMap::New(*this, m);
 }
 
+void Executable::NoteSectorUsed(int sector) {
+  AssertNoncritical();
+  anarch::ScopedLock scope(lock);
+  usedSectors[sector / 64] |= (uint64_t)1 << (sector % 64);
+}
+
+bool Executable::IsSectorUsed(int sector) {
+  AssertNoncritical();
+  anarch::ScopedLock scope(lock);
+  return (usedSectors[sector / 64] & ((uint64_t)1 << (sector % 64))) != 0;
+}
+
 }
 
 }
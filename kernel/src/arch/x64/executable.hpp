@@ -3,6 +3,7 @@
 
 #include "../all/executable.hpp"
 #include "executable-map.hpp"
+#include <anarch/lock>
 
 namespace Alux {
 
@@ -33,9 +34,26 @@ public:
     return length;
   }
   
+  /**
+   * Record that a task has used the 2MB sector at index [sector]. Every map
+   * generated from this executable afterwards maps the sector up front, so
+   * that tasks launched from the same image skip the faults of the first.
+   * @noncritical
+   */
+  void NoteSectorUsed(int sector);
+  
+  /**
+   * Returns `true` if [NoteSectorUsed] has been called for [sector].
+   * @noncritical
+   */
+  bool IsSectorUsed(int sector);
+  
 private:
   PhysAddr memory;
   size_t length;
+  
+  anarch::NoncriticalLock lock;
+  uint64_t * usedSectors;
 };
 
 }
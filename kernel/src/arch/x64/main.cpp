@@ -1,10 +1,16 @@
 #include "main.hpp"
 #include "executable.hpp"
+#include "boot-arguments.hpp"
 #include "program-image.hpp"
 #include "../../tasks/user-task.hpp"
+#include "../../tasks/kernel-task.hpp"
 #include "../../syscall/handler.hpp"
 #include "../../memory/page-fault.hpp"
-#include "../../scheduler/rr-scheduler.hpp"
+#include "../../memory/object-cache.hpp"
+#include "../../memory/heap.hpp"
+#include "../../memory/page-cache.hpp"
+#include "../../memory/zero-pool.hpp"
+#include "../../scheduler/mlfq-scheduler.hpp"
 #include <anarch/x64/multiboot-region-list>
 #include <anarch/x64/init>
 #include <anarch/api/domain-list>
@@ -51,7 +57,32 @@ void AluxMainX64(void * mbootPtr) {
   
   anarch::cout << "finished loading anarch modules!" << anarch::endl;
   
-  Alux::RRScheduler scheduler;
+  // the caches need to know the domains and must exist before any threads
+  Alux::Heap::Initialize();
+  Alux::ObjectCache::InitializeGlobal();
+  Alux::PageCache::Initialize();
+  Alux::ZeroPool::Initialize();
+  Alux::ExecutableMap::Initialize();
+  
+  // the quantum may be chosen on the command line as `quantum=<micros>`
+  Alux::x64::BootArguments arguments(mbootPtr);
+  uint64_t quantumUs = Alux::MLFQScheduler::DefaultQuantumUs;
+  if (arguments.GetInteger("quantum", quantumUs) &&
+      (quantumUs < Alux::MLFQScheduler::MinQuantumUs ||
+       quantumUs > Alux::MLFQScheduler::MaxQuantumUs)) {
+    anarch::cerr << "ignoring out of range quantum=" << quantumUs
+      << anarch::endl;
+    quantumUs = Alux::MLFQScheduler::DefaultQuantumUs;
+  }
+  Alux::MLFQScheduler scheduler(quantumUs);
+  
+  // clear pages in the background whenever the CPUs have nothing to do
+  Alux::KernelTask & zeroTask = Alux::KernelTask::New(scheduler);
+  if (!zeroTask.AddToScheduler()) {
+    anarch::Panic("AluxMainX64() - failed to add task to scheduler");
+  }
+  Alux::ZeroPool::Start(zeroTask);
+  zeroTask.Unhold();
   
   // create user task
   anarch::UserMap & map = anarch::UserMap::New();
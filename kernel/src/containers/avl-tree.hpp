@@ -0,0 +1,174 @@
+#ifndef __ALUX_AVL_TREE_HPP__
+#define __ALUX_AVL_TREE_HPP__
+
+#include <anarch/stddef>
+
+namespace Alux {
+
+/**
+ * An intrusive AVL tree of objects ordered by the key that [GetKey] returns
+ * for them. No two objects in a tree may have the same key. Like
+ * [PairingHeap], every object owns its [Link] and the tree never allocates
+ * memory or does any locking of its own.
+ *
+ * [Add], [Remove] and [FindFloor] are O(log n).
+ */
+template <class T, class K, K (* GetKey)(const T &)>
+class AVLTree {
+public:
+  class Link {
+  public:
+    Link(T & obj) : object(obj) {}
+    
+    inline T & GetObject() {
+      return object;
+    }
+  
+  private:
+    friend class AVLTree;
+    
+    T & object;
+    Link * left = NULL;
+    Link * right = NULL;
+    int height = 1;
+  };
+  
+  inline bool IsEmpty() const {
+    return root == NULL;
+  }
+  
+  /**
+   * Returns the object with the lowest key, or NULL if the tree is empty.
+   */
+  T * GetFirst() const {
+    if (!root) return NULL;
+    Link * link = root;
+    while (link->left) link = link->left;
+    return &link->object;
+  }
+  
+  /**
+   * Returns the object with the highest key which is not above [key], or
+   * NULL if there is none. For a tree of disjoint ranges keyed by their start,
+   * this is the only range which might contain [key].
+   */
+  T * FindFloor(K key) const {
+    Link * result = NULL;
+    Link * link = root;
+    while (link) {
+      if (key < GetKey(link->object)) {
+        link = link->left;
+      } else {
+        result = link;
+        link = link->right;
+      }
+    }
+    return result ? &result->object : NULL;
+  }
+  
+  /**
+   * Insert a link which is not already in a tree.
+   */
+  void Add(Link * link) {
+    link->left = link->right = NULL;
+    link->height = 1;
+    root = Insert(root, link);
+  }
+  
+  /**
+   * Remove a link which is in this tree.
+   */
+  void Remove(Link * link) {
+    root = Erase(root, GetKey(link->object));
+  }
+  
+private:
+  Link * root = NULL;
+  
+  static int GetHeight(Link * link) {
+    return link ? link->height : 0;
+  }
+  
+  static void UpdateHeight(Link * link) {
+    int left = GetHeight(link->left);
+    int right = GetHeight(link->right);
+    link->height = (left > right ? left : right) + 1;
+  }
+  
+  static Link * RotateLeft(Link * link) {
+    Link * top = link->right;
+    link->right = top->left;
+    top->left = link;
+    UpdateHeight(link);
+    UpdateHeight(top);
+    return top;
+  }
+  
+  static Link * RotateRight(Link * link) {
+    Link * top = link->left;
+    link->left = top->right;
+    top->right = link;
+    UpdateHeight(link);
+    UpdateHeight(top);
+    return top;
+  }
+  
+  static Link * Balance(Link * link) {
+    UpdateHeight(link);
+    int balance = GetHeight(link->left) - GetHeight(link->right);
+    if (balance > 1) {
+      if (GetHeight(link->left->left) < GetHeight(link->left->right)) {
+        link->left = RotateLeft(link->left);
+      }
+      return RotateRight(link);
+    } else if (balance < -1) {
+      if (GetHeight(link->right->right) < GetHeight(link->right->left)) {
+        link->right = RotateRight(link->right);
+      }
+      return RotateLeft(link);
+    }
+    return link;
+  }
+  
+  static Link * Insert(Link * node, Link * link) {
+    if (!node) return link;
+    if (GetKey(link->object) < GetKey(node->object)) {
+      node->left = Insert(node->left, link);
+    } else {
+      node->right = Insert(node->right, link);
+    }
+    return Balance(node);
+  }
+  
+  static Link * RemoveFirst(Link * node, Link *& first) {
+    if (!node->left) {
+      first = node;
+      return node->right;
+    }
+    node->left = RemoveFirst(node->left, first);
+    return Balance(node);
+  }
+  
+  static Link * Erase(Link * node, K key) {
+    if (!node) return NULL;
+    K nodeKey = GetKey(node->object);
+    if (key < nodeKey) {
+      node->left = Erase(node->left, key);
+    } else if (nodeKey < key) {
+      node->right = Erase(node->right, key);
+    } else {
+      // replace the node with the first link of its right subtree
+      if (!node->right) return node->left;
+      Link * next;
+      Link * rest = RemoveFirst(node->right, next);
+      next->left = node->left;
+      next->right = rest;
+      return Balance(next);
+    }
+    return Balance(node);
+  }
+};
+
+}
+
+#endif
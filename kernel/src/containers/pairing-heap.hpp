@@ -0,0 +1,135 @@
+#ifndef __ALUX_PAIRING_HEAP_HPP__
+#define __ALUX_PAIRING_HEAP_HPP__
+
+#include <anarch/stddef>
+
+namespace Alux {
+
+/**
+ * An intrusive min-heap ordered by [IsBefore]. Every object owns the [Link]
+ * that puts it in the heap, so the heap never allocates memory and may be
+ * used from a critical section.
+ *
+ * [Add] and [GetFirst] are O(1); [Shift] and [Remove] are amortized
+ * O(log n). The heap does no locking of its own.
+ */
+template <class T, bool (* IsBefore)(const T &, const T &)>
+class PairingHeap {
+public:
+  class Link {
+  public:
+    Link(T & obj) : object(obj) {}
+    
+    inline T & GetObject() {
+      return object;
+    }
+  
+  private:
+    friend class PairingHeap;
+    
+    T & object;
+    Link * child = NULL;
+    Link * next = NULL;
+    Link * prev = NULL; // the parent if this is the first child
+  };
+  
+  inline bool IsEmpty() const {
+    return root == NULL;
+  }
+  
+  /**
+   * Returns the first object in the heap, or NULL if the heap is empty.
+   */
+  inline T * GetFirst() const {
+    return root ? &root->object : NULL;
+  }
+  
+  /**
+   * Insert a link which is not already in a heap.
+   */
+  void Add(Link * link) {
+    link->child = NULL;
+    root = Meld(root, link);
+  }
+  
+  /**
+   * Remove and return the first object in the heap, or NULL if the heap is
+   * empty.
+   */
+  T * Shift() {
+    if (!root) return NULL;
+    Link * first = root;
+    root = MergePairs(first->child);
+    return &first->object;
+  }
+  
+  /**
+   * Remove a link which is in this heap.
+   */
+  void Remove(Link * link) {
+    if (link == root) {
+      Shift();
+      return;
+    }
+    if (link->prev->child == link) {
+      link->prev->child = link->next;
+    } else {
+      link->prev->next = link->next;
+    }
+    if (link->next) {
+      link->next->prev = link->prev;
+    }
+    root = Meld(root, MergePairs(link->child));
+  }
+  
+private:
+  Link * root = NULL;
+  
+  static Link * Detach(Link * link) {
+    if (link) link->next = link->prev = NULL;
+    return link;
+  }
+  
+  static Link * Meld(Link * a, Link * b) {
+    if (!a) return Detach(b);
+    if (!b) return Detach(a);
+    if (IsBefore(b->object, a->object)) {
+      Link * temp = a;
+      a = b;
+      b = temp;
+    }
+    Detach(a);
+    b->prev = a;
+    b->next = a->child;
+    if (a->child) a->child->prev = b;
+    a->child = b;
+    return a;
+  }
+  
+  static Link * MergePairs(Link * first) {
+    // meld siblings in pairs from left to right, collecting the results in
+    // reverse order...
+    Link * pairs = NULL;
+    while (first) {
+      Link * a = first;
+      Link * b = a->next;
+      first = b ? b->next : NULL;
+      Link * melded = Meld(a, b);
+      melded->next = pairs;
+      pairs = melded;
+    }
+    
+    // ...then meld the pairs together from right to left
+    Link * result = NULL;
+    while (pairs) {
+      Link * pair = pairs;
+      pairs = pair->next;
+      result = Meld(result, pair);
+    }
+    return result;
+  }
+};
+
+}
+
+#endif
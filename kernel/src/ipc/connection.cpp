@@ -1,4 +1,5 @@
 #include "terminal.hpp" // no need for "connection.hpp"
+#include "../memory/object-cache.hpp"
 #include <anarch/critical>
 
 namespace Alux {
@@ -15,6 +16,15 @@ void Connection::Connect(Terminal & t1, Terminal & t2) {
   c->lock.Release();
 }
 
+void * Connection::operator new(size_t size) {
+  ObjectCache & cache = ObjectCache::GetGlobal(ObjectCache::KindConnection);
+  return cache.Alloc(size);
+}
+
+void Connection::operator delete(void * ptr, size_t size) {
+  ObjectCache::Release(ptr, size);
+}
+
 void Connection::SendToRemote(Terminal & sender, const Message & m) {
   AssertCritical();
   Terminal * other = NULL;
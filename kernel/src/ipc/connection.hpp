@@ -26,6 +26,13 @@ public:
    */
   static void Connect(Terminal & t1, Terminal & t2);
   
+  /**
+   * Connections are allocated from their global [ObjectCache].
+   * @noncritical
+   */
+  static void * operator new(size_t);
+  static void operator delete(void *, size_t);
+  
 protected:
   friend class Terminal;
   friend class Port;
@@ -1,4 +1,5 @@
 #include "port.hpp" // no need to import "terminal.hpp" directly
+#include "../memory/object-cache.hpp"
 #include <anarch/critical>
 
 namespace Alux {
@@ -10,8 +11,19 @@ Terminal & Terminal::New(Port * p, GarbageCollector & c) {
   return *t;
 }
 
+void * Terminal::operator new(size_t size) {
+  ObjectCache & cache = ObjectCache::GetGlobal(ObjectCache::KindTerminal);
+  return cache.Alloc(size);
+}
+
+void Terminal::operator delete(void * ptr, size_t size) {
+  ObjectCache::Release(ptr, size);
+}
+
 Terminal::Terminal(Port * p, GarbageCollector & c)
-  : GarbageObject(c), port(p) {
+  : GarbageObject(c, WorkItem::PriorityUrgent), port(p) {
+  // deallocation tells the remote terminal that we closed, so it should not
+  // wait behind bulk frees
 }
 
 bool Terminal::Retain() {
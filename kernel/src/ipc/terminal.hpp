@@ -49,6 +49,14 @@ public:
    */
   static Terminal & New(Port *, GarbageCollector &);
   
+  /**
+   * Terminals, including those of subclasses, are allocated from their
+   * global [ObjectCache].
+   * @noncritical
+   */
+  static void * operator new(size_t);
+  static void operator delete(void *, size_t);
+  
   /**
    * Create a new terminal. The terminal will have a retain count of 1.
    * @ambicritical
@@ -0,0 +1,406 @@
+#include "anonymous-map.hpp"
+#include "zero-pool.hpp"
+#include "page-cache.hpp"
+#include <anarch/api/global-map>
+#include <anarch/api/domain>
+#include <anarch/critical>
+#include <ansa/cstring>
+
+namespace Alux {
+
+namespace {
+
+typedef anarch::MemoryMap::Size Size;
+typedef anarch::MemoryMap::Attributes Attributes;
+
+uint8_t EncodeAttributes(const Attributes & attrs) {
+  uint8_t res = 0;
+  if (attrs.executable) res |= 1;
+  if (attrs.writable) res |= 2;
+  if (attrs.cachable) res |= 4;
+  return res;
+}
+
+Attributes DecodeAttributes(uint8_t value) {
+  Attributes result;
+  result.executable = ((value & 1) != 0);
+  result.writable = ((value & 2) != 0);
+  result.cachable = ((value & 4) != 0);
+  return result;
+}
+
+}
+
+AnonymousMap::~AnonymousMap() {
+  AssertNoncritical();
+  while (Region * region = regions.GetFirst()) {
+    regions.Remove(&region->link);
+    delete region;
+  }
+}
+
+bool AnonymousMap::Create(VirtAddr & result, size_t pageCount,
+                          const Attributes & attributes) {
+  AssertNoncritical();
+  if (!pageCount || pageCount > MaxPageCount) return false;
+  bool largePages = (pageCount >= ChunkPageCount && IsLargePageSupported());
+  
+  anarch::ScopedLock scope(lock);
+  VirtAddr start;
+  if (largePages) {
+    // whole chunks, so that every chunk is aligned for a large page
+    size_t chunkCount = (pageCount + ChunkPageCount - 1) / ChunkPageCount;
+    if (!map.Reserve(start, Size(ChunkSize, chunkCount))) return false;
+    pageCount = chunkCount * ChunkPageCount;
+  } else if (!map.Reserve(start, Size(PageSize, pageCount))) {
+    return false;
+  }
+  Region * region = new Region(start, pageCount, attributes, largePages);
+  assert(region != NULL);
+  regions.Add(&region->link);
+  result = start;
+  return true;
+}
+
+bool AnonymousMap::Destroy(VirtAddr start) {
+  AssertNoncritical();
+  Region * region;
+  {
+    anarch::ScopedLock scope(lock);
+    region = regions.FindFloor(start);
+    if (!region || region->start != start) return false;
+    Unmap(*region);
+    regions.Remove(&region->link);
+  }
+  delete region;
+  return true;
+}
+
+bool AnonymousMap::Protect(VirtAddr start, size_t pageCount,
+                           const Attributes & attributes) {
+  AssertNoncritical();
+  anarch::ScopedLock scope(lock);
+  Region * region = FindRegion(start, pageCount);
+  if (!region) return false;
+  
+  size_t first = (start - region->start) / PageSize;
+  size_t end = first + pageCount;
+  for (size_t i = first / ChunkPageCount; i * ChunkPageCount < end; ++i) {
+    Chunk & chunk = region->chunks[i];
+    size_t chunkFirst = i * ChunkPageCount;
+    size_t chunkPages = region->GetChunkPageCount(i);
+    size_t from = (first > chunkFirst ? first - chunkFirst : 0);
+    size_t to = end - chunkFirst;
+    if (to > chunkPages) to = chunkPages;
+    VirtAddr chunkStart = region->GetChunkStart(i);
+    
+    if (!from && to == chunkPages) {
+      // the whole chunk changes, so a large page can stay large
+      chunk.attributes = attributes;
+      delete[] chunk.protections;
+      chunk.protections = NULL;
+      if (chunk.mode == ChunkLarge) {
+        map.UnmapAndReserve(chunkStart, Size(ChunkSize, 1));
+        map.MapAt(chunkStart, chunk.large, Size(ChunkSize, 1), attributes);
+        continue;
+      }
+    } else {
+      if (chunk.mode == ChunkLarge) Split(*region, i);
+      if (!chunk.protections) {
+        chunk.protections = new uint8_t[ChunkPageCount];
+        assert(chunk.protections != NULL);
+        char old = (char)EncodeAttributes(chunk.attributes);
+        ansa::Memset(chunk.protections, old, ChunkPageCount);
+      }
+      char value = (char)EncodeAttributes(attributes);
+      ansa::Memset(chunk.protections + from, value, to - from);
+    }
+    
+    if (!chunk.pages) continue;
+    for (size_t j = from; j < to; ++j) {
+      if (!chunk.pages[j]) continue;
+      VirtAddr addr = chunkStart + j * PageSize;
+      map.UnmapAndReserve(addr, Size(PageSize, 1));
+      map.MapAt(addr, chunk.pages[j], Size(PageSize, 1), attributes);
+    }
+  }
+  return true;
+}
+
+bool AnonymousMap::Decommit(VirtAddr start, size_t pageCount) {
+  AssertNoncritical();
+  anarch::ScopedLock scope(lock);
+  Region * region = FindRegion(start, pageCount);
+  if (!region) return false;
+  
+  size_t first = (start - region->start) / PageSize;
+  size_t end = first + pageCount;
+  for (size_t i = first / ChunkPageCount; i * ChunkPageCount < end; ++i) {
+    Chunk & chunk = region->chunks[i];
+    if (!chunk.count) continue;
+    size_t chunkFirst = i * ChunkPageCount;
+    size_t chunkPages = region->GetChunkPageCount(i);
+    size_t from = (first > chunkFirst ? first - chunkFirst : 0);
+    size_t to = end - chunkFirst;
+    if (to > chunkPages) to = chunkPages;
+    VirtAddr chunkStart = region->GetChunkStart(i);
+    
+    if (chunk.mode == ChunkLarge) {
+      if (!from && to == chunkPages) {
+        map.UnmapAndReserve(chunkStart, Size(ChunkSize, 1));
+        FreePages(chunk, 0, ChunkPageCount);
+        chunk.mode = ChunkReserved;
+        continue;
+      }
+      Split(*region, i);
+    }
+    UnmapPages(*region, i, from, to);
+    FreePages(chunk, from, to);
+    if (!chunk.count && region->largePages) {
+      map.Rereserve(chunkStart, Size(PageSize, ChunkPageCount), ChunkSize);
+      chunk.mode = ChunkReserved;
+    }
+  }
+  return true;
+}
+
+bool AnonymousMap::HandlePageFault(VirtAddr addr, bool write) {
+  AssertNoncritical();
+  anarch::ScopedLock scope(lock);
+  
+  Region * region = regions.FindFloor(addr);
+  if (!region) return false;
+  if (addr >= region->start + region->pageCount * PageSize) return false;
+  
+  size_t index = (addr - region->start) / PageSize;
+  size_t chunkIndex = index / ChunkPageCount;
+  size_t page = index % ChunkPageCount;
+  Chunk & chunk = region->chunks[chunkIndex];
+  Attributes attrs = GetAttributes(chunk, page);
+  if (write && !attrs.writable) return false;
+  if (chunk.mode == ChunkLarge) return true;
+  
+  if (!chunk.pages) {
+    chunk.pages = new PhysAddr[ChunkPageCount]();
+    assert(chunk.pages != NULL);
+  }
+  if (chunk.pages[page]) return true;
+  if (chunk.mode == ChunkReserved) {
+    map.Rereserve(region->GetChunkStart(chunkIndex), Size(ChunkSize, 1),
+                  PageSize);
+    chunk.mode = ChunkSmall;
+  }
+  
+  // clear the page before it is mapped, so that the task's other threads
+  // never see what was in it
+  PhysAddr frame;
+  if (chunk.large) {
+    // the page was decommitted from a large frame which is still in use
+    frame = chunk.large + page * PageSize;
+    if (!PageCache::Clear(frame)) return false;
+  } else {
+    bool zeroed;
+    if (!ZeroPool::Alloc(frame, zeroed)) return false;
+    if (!zeroed && !PageCache::Clear(frame)) {
+      PageCache::Free(frame);
+      return false;
+    }
+  }
+  
+  map.MapAt(region->start + index * PageSize, frame, Size(PageSize, 1),
+            attrs);
+  chunk.pages[page] = frame;
+  ++chunk.count;
+  
+  if (region->largePages && chunk.count >= PromoteCount &&
+      !chunk.protections) {
+    Promote(*region, chunkIndex);
+  }
+  return true;
+}
+
+VirtAddr AnonymousMap::GetRegionStart(const Region & region) {
+  return region.start;
+}
+
+AnonymousMap::Region::Region(VirtAddr s, size_t c, const Attributes & a,
+                             bool l)
+  : link(*this), start(s), pageCount(c), largePages(l) {
+  chunkCount = (pageCount + ChunkPageCount - 1) / ChunkPageCount;
+  chunks = new Chunk[chunkCount];
+  assert(chunks != NULL);
+  for (size_t i = 0; i < chunkCount; ++i) {
+    chunks[i].mode = (largePages ? ChunkReserved : ChunkSmall);
+    chunks[i].attributes = a;
+  }
+}
+
+AnonymousMap::Region::~Region() {
+  for (size_t i = 0; i < chunkCount; ++i) {
+    FreePages(chunks[i], 0, ChunkPageCount);
+    delete[] chunks[i].protections;
+  }
+  delete[] chunks;
+}
+
+size_t AnonymousMap::Region::GetChunkPageCount(size_t index) {
+  size_t rest = pageCount - index * ChunkPageCount;
+  return rest < ChunkPageCount ? rest : ChunkPageCount;
+}
+
+AnonymousMap::Region * AnonymousMap::FindRegion(VirtAddr start,
+                                                size_t pageCount) {
+  if (!pageCount || start % PageSize) return NULL;
+  Region * region = regions.FindFloor(start);
+  if (!region) return NULL;
+  VirtAddr end = region->start + region->pageCount * PageSize;
+  if (start >= end || pageCount > (end - start) / PageSize) return NULL;
+  return region;
+}
+
+void AnonymousMap::Unmap(Region & region) {
+  for (size_t i = 0; i < region.chunkCount; ++i) {
+    Chunk & chunk = region.chunks[i];
+    VirtAddr chunkStart = region.GetChunkStart(i);
+    if (chunk.mode == ChunkReserved) {
+      map.Unreserve(chunkStart, Size(ChunkSize, 1));
+    } else if (chunk.mode == ChunkLarge) {
+      map.Unmap(chunkStart, Size(ChunkSize, 1));
+    } else {
+      size_t chunkPages = region.GetChunkPageCount(i);
+      UnmapPages(region, i, 0, chunkPages);
+      map.Unreserve(chunkStart, Size(PageSize, chunkPages));
+    }
+  }
+}
+
+void AnonymousMap::UnmapPages(Region & region, size_t index, size_t from,
+                              size_t to) {
+  // unmap runs of pages which have frames, leaving them reserved
+  Chunk & chunk = region.chunks[index];
+  if (!chunk.pages) return;
+  VirtAddr chunkStart = region.GetChunkStart(index);
+  size_t page = from;
+  while (page < to) {
+    if (!chunk.pages[page]) {
+      ++page;
+      continue;
+    }
+    size_t runEnd = page + 1;
+    while (runEnd < to && chunk.pages[runEnd]) ++runEnd;
+    map.UnmapAndReserve(chunkStart + page * PageSize,
+                        Size(PageSize, runEnd - page));
+    page = runEnd;
+  }
+}
+
+void AnonymousMap::Promote(Region & region, size_t index) {
+  Chunk & chunk = region.chunks[index];
+  VirtAddr chunkStart = region.GetChunkStart(index);
+  anarch::Domain & domain = anarch::Domain::GetCurrent();
+  anarch::GlobalMap & global = anarch::GlobalMap::GetGlobal();
+  Size smallPages(PageSize, ChunkPageCount);
+  
+  // a chunk which was split keeps its large frame, so nothing is copied
+  bool copying = !chunk.large;
+  PhysAddr large = chunk.large;
+  if (copying && !domain.AllocPhys(large, ChunkSize, ChunkSize)) return;
+  Attributes globalAttrs;
+  globalAttrs.executable = false;
+  VirtAddr window;
+  if (!global.Map(window, large, smallPages, globalAttrs)) {
+    if (copying) domain.FreePhys(large);
+    return;
+  }
+  
+  // the small pages are unmapped first so that the task's other threads
+  // fault and wait for us rather than writing to frames we have copied
+  UnmapPages(region, index, 0, ChunkPageCount);
+  bool copied = true;
+  for (size_t i = 0; i < ChunkPageCount && copied; ++i) {
+    void * dest = (void *)(window + i * PageSize);
+    if (!chunk.pages[i]) {
+      ansa::Memset(dest, 0, PageSize);
+    } else if (copying) {
+      copied = PageCache::Copy(dest, chunk.pages[i]);
+    }
+  }
+  global.Unmap(window, smallPages);
+  
+  if (!copied) {
+    for (size_t i = 0; i < ChunkPageCount; ++i) {
+      if (!chunk.pages[i]) continue;
+      map.MapAt(chunkStart + i * PageSize, chunk.pages[i], Size(PageSize, 1),
+                chunk.attributes);
+    }
+    domain.FreePhys(large);
+    return;
+  }
+  
+  if (copying) {
+    FreePages(chunk, 0, ChunkPageCount);
+    chunk.pages = new PhysAddr[ChunkPageCount];
+    assert(chunk.pages != NULL);
+    chunk.large = large;
+  }
+  for (size_t i = 0; i < ChunkPageCount; ++i) {
+    chunk.pages[i] = large + i * PageSize;
+  }
+  chunk.count = ChunkPageCount;
+  map.Rereserve(chunkStart, smallPages, ChunkSize);
+  map.MapAt(chunkStart, large, Size(ChunkSize, 1), chunk.attributes);
+  chunk.mode = ChunkLarge;
+}
+
+void AnonymousMap::Split(Region & region, size_t index) {
+  // a large chunk has one set of attributes and every page mapped, so its
+  // frame can be mapped again as small pages in one go
+  Chunk & chunk = region.chunks[index];
+  VirtAddr chunkStart = region.GetChunkStart(index);
+  map.UnmapAndReserve(chunkStart, Size(ChunkSize, 1));
+  map.Rereserve(chunkStart, Size(ChunkSize, 1), PageSize);
+  map.MapAt(chunkStart, chunk.large, Size(PageSize, ChunkPageCount),
+            chunk.attributes);
+  chunk.mode = ChunkSmall;
+}
+
+bool AnonymousMap::IsLargePageSupported() {
+  for (int i = 0; i < anarch::UserMap::GetPageSizeCount(); ++i) {
+    if (anarch::UserMap::GetPageSize(i) == ChunkSize) return true;
+  }
+  return false;
+}
+
+void AnonymousMap::FreePages(Chunk & chunk, size_t from, size_t to) {
+  if (!chunk.pages) return;
+  PhysAddr batch[PageCache::BatchSize];
+  int batchCount = 0;
+  for (size_t i = from; i < to; ++i) {
+    PhysAddr frame = chunk.pages[i];
+    if (!frame) continue;
+    chunk.pages[i] = 0;
+    --chunk.count;
+    // pages of a large frame are only given back with the whole frame
+    if (chunk.large) continue;
+    batch[batchCount++] = frame;
+    if (batchCount == PageCache::BatchSize) {
+      PageCache::FreeBatch(batch, batchCount);
+      batchCount = 0;
+    }
+  }
+  if (batchCount) PageCache::FreeBatch(batch, batchCount);
+  
+  if (!chunk.count) {
+    if (chunk.large) anarch::Domain::GetCurrent().FreePhys(chunk.large);
+    chunk.large = 0;
+    delete[] chunk.pages;
+    chunk.pages = NULL;
+  }
+}
+
+Attributes AnonymousMap::GetAttributes(Chunk & chunk, size_t page) {
+  if (!chunk.protections) return chunk.attributes;
+  return DecodeAttributes(chunk.protections[page]);
+}
+
+}
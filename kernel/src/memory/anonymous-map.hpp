@@ -0,0 +1,136 @@
+#ifndef __ALUX_ANONYMOUS_MAP_HPP__
+#define __ALUX_ANONYMOUS_MAP_HPP__
+
+#include "../containers/avl-tree.hpp"
+#include <anarch/api/user-map>
+#include <anarch/lock>
+
+namespace Alux {
+
+/**
+ * The anonymous regions of a [UserTask]. A region starts out as nothing but
+ * a reservation in the task's [anarch::UserMap]; each of its 4 KiB pages is
+ * given a zeroed frame the first time the task touches it.
+ *
+ * Regions are kept in an [AVLTree] by their start address, so the fault
+ * path finds the region behind an address in O(log n). The frames of a
+ * region are recorded per 2 MiB chunk, and a chunk's list of frames is only
+ * allocated once one of its pages is touched.
+ *
+ * A region of at least [ChunkSize] bytes is rounded up to whole chunks and
+ * reserved with large pages. Once [PromoteCount] pages of such a chunk have
+ * been touched, the chunk is moved onto a single 2 MiB frame and mapped as
+ * one large page. Decommitting or protecting part of a large chunk maps it
+ * as 4 KiB pages of the same frame again.
+ *
+ * Destroying the map frees every frame without unmapping anything, so it
+ * should only happen after the task's memory map is gone.
+ */
+class AnonymousMap {
+public:
+  static const size_t PageSize = 0x1000;
+  static const size_t ChunkSize = 0x200000;
+  static const size_t ChunkPageCount = ChunkSize / PageSize;
+  static const size_t PromoteCount = ChunkPageCount * 7 / 8;
+  static const size_t MaxPageCount = (size_t)1 << 26;
+  
+  AnonymousMap(anarch::UserMap & m) : map(m) {} // @ambicritical
+  ~AnonymousMap(); // @noncritical
+  
+  /**
+   * Reserve [pageCount] pages somewhere in the map and make them a region.
+   * Returns `false` if there is no room for them.
+   * @noncritical
+   */
+  bool Create(VirtAddr & result, size_t pageCount,
+              const anarch::MemoryMap::Attributes & attributes);
+  
+  /**
+   * Unmap and unreserve the region which starts at [start], freeing its
+   * frames. Returns `false` if no region starts there.
+   * @noncritical
+   */
+  bool Destroy(VirtAddr start);
+  
+  /**
+   * Change the attributes of [pageCount] pages at [start], which must all be
+   * in one region. Returns `false` if they are not.
+   * @noncritical
+   */
+  bool Protect(VirtAddr start, size_t pageCount,
+               const anarch::MemoryMap::Attributes & attributes);
+  
+  /**
+   * Unmap [pageCount] pages at [start] and free their frames, so that they
+   * read as zero the next time they are touched. The pages must all be in one
+   * region; returns `false` if they are not.
+   * @noncritical
+   */
+  bool Decommit(VirtAddr start, size_t pageCount);
+  
+  /**
+   * If [addr] is in a region and the access is allowed, give its page a
+   * frame and return `true`. A page which already has a frame is left alone,
+   * since another thread of the task may have faulted on it first.
+   * @noncritical
+   */
+  bool HandlePageFault(VirtAddr addr, bool write);
+  
+private:
+  struct Region;
+  
+  static VirtAddr GetRegionStart(const Region &);
+  
+  typedef AVLTree<Region, VirtAddr, GetRegionStart> RegionTree;
+  
+  enum ChunkMode {
+    ChunkReserved, // reserved as one large page, never touched
+    ChunkSmall, // reserved and mapped as 4 KiB pages
+    ChunkLarge // mapped as one large page of [Chunk::large]
+  };
+  
+  struct Chunk {
+    ChunkMode mode;
+    size_t count = 0;
+    PhysAddr * pages = NULL; // [ChunkPageCount] frames, or 0s for untouched
+    PhysAddr large = 0; // if set, [pages] all point into this frame
+    anarch::MemoryMap::Attributes attributes;
+    uint8_t * protections = NULL; // per-page attributes, once they differ
+  };
+  
+  struct Region {
+    Region(VirtAddr, size_t, const anarch::MemoryMap::Attributes &, bool);
+    ~Region(); // frees the region's frames; @noncritical
+    
+    RegionTree::Link link;
+    VirtAddr start;
+    size_t pageCount;
+    bool largePages;
+    size_t chunkCount;
+    Chunk * chunks;
+    
+    inline VirtAddr GetChunkStart(size_t index) {
+      return start + index * ChunkSize;
+    }
+    
+    size_t GetChunkPageCount(size_t index);
+  };
+  
+  anarch::UserMap & map;
+  anarch::NoncriticalLock lock;
+  RegionTree regions;
+  
+  Region * FindRegion(VirtAddr start, size_t pageCount);
+  void Unmap(Region &);
+  void UnmapPages(Region &, size_t chunk, size_t from, size_t to);
+  void Promote(Region &, size_t chunk);
+  void Split(Region &, size_t chunk);
+  
+  static bool IsLargePageSupported();
+  static void FreePages(Chunk &, size_t from, size_t to);
+  static anarch::MemoryMap::Attributes GetAttributes(Chunk &, size_t page);
+};
+
+}
+
+#endif
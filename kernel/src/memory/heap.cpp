@@ -0,0 +1,135 @@
+#include "heap.hpp"
+#include <anarch/api/domain>
+#include <anarch/critical>
+#include <ansa/atomic>
+
+namespace Alux {
+
+namespace {
+
+// for a small block, [size] is the spare word of its ObjectCache and [tag]
+// is its slab pointer
+struct Prefix {
+  uint64_t size; // the number of bytes that were asked for
+  uint64_t tag;
+};
+
+struct LargeCounters {
+  ansa::Atomic<uint64_t> allocations;
+  ansa::Atomic<uint64_t> frees;
+  ansa::Atomic<uint64_t> requested;
+};
+
+// the tags of blocks which did not come from a size class; boot blocks were
+// allocated before there were counters for them. Slabs are aligned, so no
+// slab pointer has either value.
+const uint64_t LargeTag = 1;
+const uint64_t BootTag = 2;
+
+const char * classNames[Heap::ClassCount] = {
+  "heap-32", "heap-64", "heap-128", "heap-256", "heap-512", "heap-1024",
+  "heap-2048"
+};
+
+ObjectCache * classCaches[Heap::ClassCount];
+LargeCounters * largeCounters;
+
+int GetClass(size_t size) {
+  size_t classSize = Heap::MinClassSize;
+  for (int i = 0; i < Heap::ClassCount; ++i) {
+    if (size <= classSize) return i;
+    classSize <<= 1;
+  }
+  return -1;
+}
+
+}
+
+void Heap::Initialize() {
+  AssertNoncritical();
+  static_assert(sizeof(Prefix) == PrefixSize, "Prefix has the wrong size");
+  LargeCounters * counters = new LargeCounters();
+  assert(counters != NULL);
+  counters->allocations = 0;
+  counters->frees = 0;
+  counters->requested = 0;
+  largeCounters = counters;
+  
+  size_t classSize = MinClassSize;
+  for (int i = 0; i < ClassCount; ++i) {
+    ObjectCache * cache = new ObjectCache(classNames[i], classSize,
+                                          PrefixSize);
+    assert(cache != NULL);
+    classCaches[i] = cache;
+    classSize <<= 1;
+  }
+}
+
+void * Heap::Alloc(size_t size) {
+  AssertNoncritical();
+  int index = GetClass(size);
+  if (index >= 0 && classCaches[index]) {
+    void * block = classCaches[index]->Alloc(size);
+    if (!block) return NULL;
+    ObjectCache::GetSpareWord(block) = size;
+    return block;
+  }
+  
+  void * memory;
+  if (!anarch::Domain::GetCurrent().Alloc(memory, size + PrefixSize)) {
+    return NULL;
+  }
+  Prefix * prefix = (Prefix *)memory;
+  prefix->size = size;
+  if (largeCounters) {
+    prefix->tag = LargeTag;
+    ++largeCounters->allocations;
+    largeCounters->requested += size;
+  } else {
+    prefix->tag = BootTag;
+  }
+  return (void *)(prefix + 1);
+}
+
+void Heap::Free(void * ptr) {
+  AssertNoncritical();
+  if (!ptr) return;
+  Prefix * prefix = (Prefix *)ptr - 1;
+  if (prefix->tag == LargeTag) {
+    ++largeCounters->frees;
+    largeCounters->requested -= prefix->size;
+  } else if (prefix->tag != BootTag) {
+    // the tag is a slab pointer, which tells Release() the block's cache
+    ObjectCache::Release(ptr, ObjectCache::GetSpareWord(ptr));
+    return;
+  }
+  anarch::Domain::GetCurrent().Free((void *)prefix);
+}
+
+bool Heap::GetStats(int index, ObjectCacheStats & stats) {
+  AssertCritical();
+  if (index < 0 || index > ClassCount) return false;
+  if (index < ClassCount) {
+    if (!classCaches[index]) return false;
+    classCaches[index]->GetStats(stats);
+    return true;
+  }
+  if (!largeCounters) return false;
+  
+  const char * name = "heap-large";
+  for (int i = 0; i < (int)sizeof(stats.name); ++i) {
+    stats.name[i] = name[i];
+    if (!name[i]) break;
+  }
+  stats.objectSize = 0;
+  stats.allocations = largeCounters->allocations;
+  stats.frees = largeCounters->frees;
+  stats.used = stats.allocations - stats.frees;
+  stats.slabs = stats.used;
+  stats.objects = stats.used;
+  stats.cached = 0;
+  stats.requested = largeCounters->requested;
+  return true;
+}
+
+}
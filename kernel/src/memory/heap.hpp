@@ -0,0 +1,58 @@
+#ifndef __ALUX_HEAP_HPP__
+#define __ALUX_HEAP_HPP__
+
+#include "object-cache.hpp"
+
+namespace Alux {
+
+/**
+ * The front end of the general kernel heap, which the global `operator new`
+ * and `operator delete` go through.
+ *
+ * Small blocks come from one [ObjectCache] per size class, so they are taken
+ * from and given back to a per-CPU magazine without a lock. A block freed on
+ * another CPU sits in that CPU's magazine until half of the magazine is
+ * returned to the slabs of the block's own domain in one batch. Blocks larger
+ * than the biggest class go straight to the domain allocator.
+ *
+ * Every block is preceded by a [PrefixSize] byte prefix holding the number
+ * of bytes asked for and a tag. A small block shares this prefix with its
+ * [ObjectCache]: the tag is the block's slab pointer, and the size goes in
+ * the cache's spare word, so a small block costs nothing beyond its slab
+ * slot. Other blocks are tagged with a value that no slab pointer can have.
+ */
+class Heap {
+public:
+  static const int ClassCount = 7;
+  static const size_t MinClassSize = 0x20;
+  static const size_t PrefixSize = 0x10;
+  
+  /**
+   * Create the size classes. Until this is called, and while it runs, every
+   * block goes to the domain allocator.
+   * @noncritical
+   */
+  static void Initialize();
+  
+  /**
+   * @noncritical
+   */
+  static void * Alloc(size_t size);
+  
+  /**
+   * @noncritical
+   */
+  static void Free(void * ptr);
+  
+  /**
+   * Read the counters of size class [index]. An [index] of [ClassCount]
+   * reads the counters of large blocks, which have an [objectSize] of 0 and
+   * one slab each. Returns `false` if [index] is out of range.
+   * @critical
+   */
+  static bool GetStats(int index, ObjectCacheStats &);
+};
+
+}
+
+#endif
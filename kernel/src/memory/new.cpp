@@ -1,31 +1,23 @@
 #include "new.hpp"
-#include <anarch/api/domain>
+#include "heap.hpp"
 #include <anarch/critical>
 
 void * operator new(size_t s) {
   AssertNoncritical();
-  void * result;
-  if (!anarch::Domain::GetCurrent().Alloc(result, s)) {
-    return NULL;
-  }
-  return result;
+  return Alux::Heap::Alloc(s);
 }
 
 void * operator new[](size_t s) {
   AssertNoncritical();
-  void * result;
-  if (!anarch::Domain::GetCurrent().Alloc(result, s)) {
-    return NULL;
-  }
-  return result;
+  return Alux::Heap::Alloc(s);
 }
 
 void operator delete(void * p) {
   AssertNoncritical();
-  anarch::Domain::GetCurrent().Free(p);
+  Alux::Heap::Free(p);
 }
 
 void operator delete[](void * p) {
   AssertNoncritical();
-  anarch::Domain::GetCurrent().Free(p);
+  Alux::Heap::Free(p);
 }
@@ -0,0 +1,316 @@
+#include "object-cache.hpp"
+#include "../threads/thread.hpp"
+#include "../threads/thread-port.hpp"
+#include "../tasks/user-task.hpp"
+#include "../tasks/kernel-task.hpp"
+#include "../ipc/terminal.hpp"
+#include "../scheduler/queue-scheduler.hpp"
+#include <anarch/api/domain-list>
+#include <anarch/api/panic>
+#include <anarch/critical>
+#include <ansa/cstring>
+
+namespace Alux {
+
+namespace {
+
+ObjectCache * globalCaches[ObjectCache::KindCount];
+
+size_t RoundUp(size_t value, size_t alignment) {
+  return (value + alignment - 1) & ~(alignment - 1);
+}
+
+size_t Max(size_t a, size_t b) {
+  return a > b ? a : b;
+}
+
+}
+
+void ObjectCache::InitializeGlobal() {
+  AssertNoncritical();
+  globalCaches[KindThread] = new ObjectCache("Thread", sizeof(Thread),
+                                             CacheLineSize);
+  globalCaches[KindTask] = new ObjectCache("Task",
+                                           Max(sizeof(UserTask),
+                                               sizeof(KernelTask)),
+                                           CacheLineSize);
+  globalCaches[KindThreadPort] = new ObjectCache("ThreadPort",
+                                                 sizeof(ThreadPort), 0x10);
+  globalCaches[KindTerminal] = new ObjectCache("Terminal", sizeof(Terminal),
+                                               0x10);
+  // the two ends of a connection contend for its lock from different CPUs
+  globalCaches[KindConnection] = new ObjectCache("Connection",
+                                                 sizeof(Connection),
+                                                 CacheLineSize);
+  globalCaches[KindThreadObj] =
+    new ObjectCache("ThreadObj", QueueScheduler::MaxThreadObjSize,
+                    CacheLineSize);
+  for (int i = 0; i < KindCount; ++i) {
+    assert(globalCaches[i] != NULL);
+  }
+}
+
+ObjectCache & ObjectCache::GetGlobal(Kind kind) {
+  assert(kind >= 0 && kind < KindCount);
+  if (!globalCaches[kind]) {
+    anarch::Panic("ObjectCache::GetGlobal() - caches not initialized");
+  }
+  return *globalCaches[kind];
+}
+
+void ObjectCache::Release(void * object, size_t requested) {
+  AssertNoncritical();
+  if (!object) return;
+  GetSlabPointer(object)->cache->Free(object, requested);
+}
+
+ObjectCache::ObjectCache(const char * _name, size_t size, size_t alignment)
+  : name(_name), objectSize(size) {
+  AssertNoncritical();
+  assert(alignment >= sizeof(void *));
+  assert(!(alignment & (alignment - 1)));
+  assert(objectSize >= sizeof(void *));
+  
+  // the slack of [alignment] bytes lets the first object be aligned however
+  // the domain allocator aligns the slab
+  padding = RoundUp(sizeof(Slab *), alignment);
+  stride = padding + RoundUp(objectSize, alignment);
+  size_t overhead = RoundUp(sizeof(Slab), alignment) + alignment;
+  slabSize = Max(MinSlabSize, overhead + stride * MinSlabObjects);
+  slabObjects = (int)((slabSize - overhead) / stride);
+  objectAlign = alignment;
+  
+  anarch::DomainList & domains = anarch::DomainList::GetGlobal();
+  depotCount = domains.GetCount();
+  depots = new Depot[depotCount];
+  assert(depots != NULL);
+  magazineCount = 0;
+  for (int i = 0; i < depotCount; ++i) {
+    depots[i].domain = &domains[i];
+    magazineCount += domains[i].GetThreadCount();
+  }
+  size_t magazineBytes = sizeof(Magazine) * magazineCount + CacheLineSize;
+  magazineMemory = new uint8_t[magazineBytes];
+  assert(magazineMemory != NULL);
+  ansa::Memset(magazineMemory, 0, magazineBytes);
+  magazines = (Magazine *)RoundUp((size_t)magazineMemory, CacheLineSize);
+  Magazine * magazine = magazines;
+  for (int i = 0; i < depotCount; ++i) {
+    for (int j = 0; j < domains[i].GetThreadCount(); ++j) {
+      (magazine++)->cpu = &domains[i].GetThread(j);
+    }
+  }
+}
+
+ObjectCache::~ObjectCache() {
+  AssertNoncritical();
+  // every object must have been freed; only the kept slabs are left
+  for (int i = 0; i < depotCount; ++i) {
+    if (depots[i].empty) {
+      depots[i].domain->Free((void *)depots[i].empty);
+    }
+  }
+  delete[] depots;
+  delete[] magazineMemory;
+}
+
+void * ObjectCache::Alloc(size_t requested) {
+  AssertNoncritical();
+  assert(requested <= objectSize);
+  while (1) {
+    {
+      anarch::ScopedCritical critical;
+      Magazine & magazine = GetMagazine();
+      if (magazine.count || Refill(magazine)) {
+        ++magazine.allocations;
+        magazine.requested += (int64_t)requested;
+        return magazine.objects[--magazine.count];
+      }
+    }
+    if (!Grow()) return NULL;
+  }
+}
+
+void ObjectCache::Free(void * object, size_t requested) {
+  AssertNoncritical();
+  Slab * freed[MagazineSize];
+  int freedCount = 0;
+  {
+    anarch::ScopedCritical critical;
+    Magazine & magazine = GetMagazine();
+    if (magazine.count == MagazineSize) {
+      freedCount = Flush(magazine, MagazineSize / 2, freed);
+    }
+    magazine.objects[magazine.count++] = object;
+    ++magazine.frees;
+    magazine.requested -= (int64_t)requested;
+  }
+  for (int i = 0; i < freedCount; ++i) {
+    freed[i]->depot->domain->Free((void *)freed[i]);
+  }
+}
+
+void ObjectCache::GetStats(ObjectCacheStats & stats) {
+  AssertCritical();
+  int i;
+  for (i = 0; i < (int)sizeof(stats.name) - 1 && name[i]; ++i) {
+    stats.name[i] = name[i];
+  }
+  for (; i < (int)sizeof(stats.name); ++i) {
+    stats.name[i] = 0;
+  }
+  stats.objectSize = objectSize;
+  stats.slabs = 0;
+  for (i = 0; i < depotCount; ++i) {
+    anarch::ScopedLock scope(depots[i].lock);
+    stats.slabs += depots[i].slabCount;
+  }
+  stats.objects = stats.slabs * slabObjects;
+  
+  // the magazines are read without their CPUs' cooperation, so these counts
+  // may be slightly out of date
+  stats.cached = 0;
+  stats.allocations = 0;
+  stats.frees = 0;
+  int64_t requested = 0;
+  for (i = 0; i < magazineCount; ++i) {
+    stats.cached += magazines[i].count;
+    stats.allocations += magazines[i].allocations;
+    stats.frees += magazines[i].frees;
+    requested += magazines[i].requested;
+  }
+  stats.requested = (uint64_t)requested;
+  stats.used = stats.allocations - stats.frees;
+}
+
+ObjectCache::Magazine & ObjectCache::GetMagazine() {
+  AssertCritical();
+  anarch::Thread & current = anarch::Thread::GetCurrent();
+  for (int i = 0; i < magazineCount; ++i) {
+    if (magazines[i].cpu == &current) return magazines[i];
+  }
+  anarch::Panic("ObjectCache::GetMagazine() - unknown CPU");
+}
+
+ObjectCache::Depot & ObjectCache::GetDepot(anarch::Domain & domain) {
+  for (int i = 0; i < depotCount; ++i) {
+    if (depots[i].domain == &domain) return depots[i];
+  }
+  anarch::Panic("ObjectCache::GetDepot() - unknown domain");
+}
+
+bool ObjectCache::Refill(Magazine & magazine) {
+  AssertCritical();
+  Depot & depot = GetDepot(anarch::Domain::GetCurrent());
+  anarch::ScopedLock scope(depot.lock);
+  while (magazine.count < MagazineSize / 2) {
+    Slab * slab = depot.partial;
+    if (!slab) {
+      slab = depot.empty;
+      if (!slab) break;
+      depot.empty = NULL;
+      AddPartial(depot, *slab);
+    }
+    void * object = slab->freeList;
+    slab->freeList = *(void **)object;
+    ++slab->used;
+    magazine.objects[magazine.count++] = object;
+    if (!slab->freeList) RemovePartial(depot, *slab);
+  }
+  return magazine.count != 0;
+}
+
+int ObjectCache::Flush(Magazine & magazine, int count, Slab ** freed) {
+  AssertCritical();
+  // give back the coldest objects and keep the ones freed most recently;
+  // objects from the same domain tend to be freed together, so a depot's
+  // lock is held for as long as the objects keep coming from it
+  int freedCount = 0;
+  Depot * locked = NULL;
+  for (int i = 0; i < count; ++i) {
+    void * object = magazine.objects[i];
+    Slab * slab = GetSlabPointer(object);
+    Depot & depot = *slab->depot;
+    if (locked != &depot) {
+      if (locked) locked->lock.Release();
+      locked = &depot;
+      depot.lock.Seize();
+    }
+    *(void **)object = slab->freeList;
+    slab->freeList = object;
+    if (!slab->listed) AddPartial(depot, *slab);
+    if (--slab->used) continue;
+    RemovePartial(depot, *slab);
+    if (!depot.empty) {
+      depot.empty = slab;
+    } else {
+      --depot.slabCount;
+      freed[freedCount++] = slab;
+    }
+  }
+  if (locked) locked->lock.Release();
+  for (int i = count; i < magazine.count; ++i) {
+    magazine.objects[i - count] = magazine.objects[i];
+  }
+  magazine.count -= count;
+  return freedCount;
+}
+
+bool ObjectCache::Grow() {
+  AssertNoncritical();
+  anarch::Domain & domain = anarch::Domain::GetCurrent();
+  void * memory;
+  if (!domain.Alloc(memory, slabSize)) return false;
+  Depot & depot = GetDepot(domain);
+  
+  Slab * slab = (Slab *)memory;
+  slab->cache = this;
+  slab->depot = &depot;
+  slab->next = slab->last = NULL;
+  slab->freeList = NULL;
+  slab->used = 0;
+  slab->listed = false;
+  
+  size_t start = RoundUp((size_t)memory + sizeof(Slab), objectAlign);
+  for (int i = slabObjects - 1; i >= 0; --i) {
+    void * object = (void *)(start + stride * i + padding);
+    GetSlabPointer(object) = slab;
+    *(void **)object = slab->freeList;
+    slab->freeList = object;
+  }
+  
+  anarch::ScopedCritical critical;
+  anarch::ScopedLock scope(depot.lock);
+  ++depot.slabCount;
+  AddPartial(depot, *slab);
+  return true;
+}
+
+void ObjectCache::AddPartial(Depot & depot, Slab & slab) {
+  AssertCritical();
+  assert(!slab.listed);
+  slab.listed = true;
+  slab.last = NULL;
+  slab.next = depot.partial;
+  if (depot.partial) depot.partial->last = &slab;
+  depot.partial = &slab;
+}
+
+void ObjectCache::RemovePartial(Depot & depot, Slab & slab) {
+  AssertCritical();
+  assert(slab.listed);
+  slab.listed = false;
+  if (slab.last) {
+    slab.last->next = slab.next;
+  } else {
+    depot.partial = slab.next;
+  }
+  if (slab.next) slab.next->last = slab.last;
+  slab.next = slab.last = NULL;
+}
+
+ObjectCache::Slab *& ObjectCache::GetSlabPointer(void * object) {
+  return ((Slab **)object)[-1];
+}
+
+}
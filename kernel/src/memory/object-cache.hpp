@@ -0,0 +1,193 @@
+#ifndef __ALUX_OBJECT_CACHE_HPP__
+#define __ALUX_OBJECT_CACHE_HPP__
+
+#include <anarch/api/domain>
+#include <anarch/api/thread>
+#include <anarch/lock>
+#include <anarch/stdint>
+#include <anarch/stddef>
+
+namespace Alux {
+
+/**
+ * The counters of an [ObjectCache], in the form that user space reads them.
+ */
+struct ObjectCacheStats {
+  char name[16];
+  uint64_t objectSize = 0;
+  uint64_t slabs = 0; // slabs allocated from the domain allocators
+  uint64_t objects = 0; // objects that the slabs hold altogether
+  uint64_t used = 0; // objects allocated and not yet freed
+  uint64_t cached = 0; // free objects waiting in per-CPU magazines
+  uint64_t requested = 0; // bytes that the callers asked for in [used]
+  uint64_t allocations = 0;
+  uint64_t frees = 0;
+};
+
+/**
+ * Allocates objects of one size from slabs, so that creating and destroying
+ * a hot kind of kernel object seldom touches the domain allocator.
+ *
+ * Every CPU has a magazine of free objects which it uses from a critical
+ * section without taking any lock. When a magazine runs dry or fills up, half
+ * of it is moved from or to the slabs of the domain, under the domain's lock.
+ * Each domain keeps a list of its partly used slabs and holds on to one empty
+ * slab; other empty slabs are given back to the domain allocator.
+ *
+ * Every object is preceded by a pointer to its slab, so [Release] can free
+ * an object without knowing which cache it came from. In a cache aligned to
+ * at least 16 bytes, the word before that pointer is never touched by the
+ * cache and belongs to whoever allocated the object; see [GetSpareWord].
+ */
+class ObjectCache {
+public:
+  static const size_t MinSlabSize = 0x4000;
+  static const int MinSlabObjects = 8;
+  static const int MagazineSize = 16;
+  static const size_t CacheLineSize = 0x40;
+  
+  /**
+   * The hot kinds of kernel objects, each of which has a global cache.
+   */
+  enum Kind {
+    KindThread,
+    KindTask,
+    KindThreadPort,
+    KindTerminal,
+    KindConnection,
+    KindThreadObj,
+    KindCount
+  };
+  
+  /**
+   * Create the global caches. Call this once, after the domains have been
+   * loaded and before any of the hot objects are created.
+   * @noncritical
+   */
+  static void InitializeGlobal();
+  
+  /**
+   * Get the global cache for a kind of object.
+   * @ambicritical
+   */
+  static ObjectCache & GetGlobal(Kind);
+  
+  /**
+   * Free an object which came from any cache. [requested] must match what
+   * was passed to [Alloc].
+   * @noncritical
+   */
+  static void Release(void * object, size_t requested);
+  
+  /**
+   * Return the spare word in front of an object from a cache whose alignment
+   * is at least 16 bytes. The cache itself never reads or writes it.
+   * @ambicritical
+   */
+  static inline uint64_t & GetSpareWord(void * object) {
+    return ((uint64_t *)object)[-2];
+  }
+  
+  /**
+   * Create a cache of objects which are [objectSize] bytes long and start on
+   * a multiple of [alignment], which must be a power of two.
+   * @noncritical
+   */
+  ObjectCache(const char * name, size_t objectSize, size_t alignment);
+  
+  /**
+   * @noncritical
+   */
+  ~ObjectCache();
+  
+  /**
+   * Allocate an object for [requested] bytes, which must be no more than
+   * [GetObjectSize], or return `NULL` if the domain allocator has run out.
+   * @noncritical
+   */
+  void * Alloc(size_t requested);
+  
+  /**
+   * Give back an object which came from this cache. [requested] must match
+   * what was passed to [Alloc].
+   * @noncritical
+   */
+  void Free(void * object, size_t requested);
+  
+  /**
+   * @ambicritical
+   */
+  inline size_t GetObjectSize() {
+    return objectSize;
+  }
+  
+  /**
+   * @critical
+   */
+  void GetStats(ObjectCacheStats &);
+  
+private:
+  struct Depot;
+  
+  // a slab header is written over raw memory, so it is a plain structure
+  // with its own list pointers
+  struct Slab {
+    ObjectCache * cache;
+    Depot * depot;
+    
+    // these are protected by the lock of [depot]
+    Slab * next;
+    Slab * last;
+    void * freeList;
+    int used;
+    bool listed;
+  };
+  
+  struct Depot {
+    anarch::Domain * domain = NULL;
+    anarch::CriticalLock lock;
+    Slab * partial = NULL;
+    Slab * empty = NULL;
+    uint64_t slabCount = 0;
+  };
+  
+  // each magazine fills whole cache lines, so that CPUs never write to the
+  // same line; the heap does not align that far, so the magazines are
+  // written over raw memory which is aligned by hand
+  struct alignas(CacheLineSize) Magazine {
+    anarch::Thread * cpu;
+    void * objects[MagazineSize];
+    int count;
+    uint64_t allocations;
+    uint64_t frees;
+    int64_t requested; // may go negative when objects migrate
+  };
+  
+  const char * name;
+  size_t objectSize;
+  size_t objectAlign;
+  size_t stride; // the distance between objects in a slab
+  size_t padding; // the space before each object holding its slab pointer
+  size_t slabSize;
+  int slabObjects;
+  
+  Depot * depots;
+  int depotCount;
+  Magazine * magazines;
+  int magazineCount;
+  uint8_t * magazineMemory;
+  
+  Magazine & GetMagazine(); // @critical
+  Depot & GetDepot(anarch::Domain &); // @ambicritical
+  bool Refill(Magazine &); // @critical
+  int Flush(Magazine &, int count, Slab ** freed); // @critical
+  bool Grow(); // @noncritical
+  void AddPartial(Depot &, Slab &); // @critical
+  void RemovePartial(Depot &, Slab &); // @critical
+  
+  static Slab *& GetSlabPointer(void * object); // @ambicritical
+};
+
+}
+
+#endif
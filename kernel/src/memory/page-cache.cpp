@@ -0,0 +1,165 @@
+#include "page-cache.hpp"
+#include "object-cache.hpp"
+#include <anarch/api/domain-list>
+#include <anarch/api/domain>
+#include <anarch/api/global-map>
+#include <anarch/api/thread>
+#include <anarch/api/panic>
+#include <anarch/critical>
+#include <ansa/cstring>
+
+namespace Alux {
+
+namespace {
+
+const size_t CacheLineSize = ObjectCache::CacheLineSize;
+
+// each stack fills whole cache lines, so that CPUs never write to the same
+// line; the heap does not align that far, so the stacks are written over raw
+// memory which is aligned by hand
+struct alignas(CacheLineSize) Stack {
+  anarch::Thread * cpu;
+  PhysAddr pages[PageCache::Capacity];
+  int count;
+};
+
+Stack * stacks;
+int stackCount;
+
+Stack & GetCurrentStack() {
+  AssertCritical();
+  anarch::Thread & current = anarch::Thread::GetCurrent();
+  for (int i = 0; i < stackCount; ++i) {
+    if (stacks[i].cpu == &current) return stacks[i];
+  }
+  anarch::Panic("PageCache - unknown CPU");
+}
+
+}
+
+void PageCache::Initialize() {
+  AssertNoncritical();
+  anarch::DomainList & domains = anarch::DomainList::GetGlobal();
+  int count = 0;
+  for (int i = 0; i < domains.GetCount(); ++i) {
+    count += domains[i].GetThreadCount();
+  }
+  size_t bytes = sizeof(Stack) * count + CacheLineSize;
+  uint8_t * memory = new uint8_t[bytes];
+  assert(memory != NULL);
+  ansa::Memset(memory, 0, bytes);
+  size_t start = ((size_t)memory + CacheLineSize - 1) & ~(CacheLineSize - 1);
+  Stack * list = (Stack *)start;
+  Stack * stack = list;
+  for (int i = 0; i < domains.GetCount(); ++i) {
+    for (int j = 0; j < domains[i].GetThreadCount(); ++j) {
+      (stack++)->cpu = &domains[i].GetThread(j);
+    }
+  }
+  stackCount = count;
+  stacks = list;
+}
+
+bool PageCache::Alloc(PhysAddr & result) {
+  AssertNoncritical();
+  anarch::Domain & domain = anarch::Domain::GetCurrent();
+  if (!stacks) {
+    return domain.AllocPhys(result, PageSize, PageSize);
+  }
+  {
+    anarch::ScopedCritical critical;
+    Stack & stack = GetCurrentStack();
+    if (stack.count) {
+      result = stack.pages[--stack.count];
+      return true;
+    }
+  }
+  
+  // refill from the domain, keeping the last page for ourselves
+  PhysAddr batch[BatchSize];
+  int count = 0;
+  while (count < BatchSize) {
+    if (!domain.AllocPhys(batch[count], PageSize, PageSize)) break;
+    ++count;
+  }
+  if (!count) return false;
+  result = batch[--count];
+  {
+    // we may be on a different CPU by now, whose stack may have filled up
+    anarch::ScopedCritical critical;
+    Stack & stack = GetCurrentStack();
+    while (count && stack.count < Capacity) {
+      stack.pages[stack.count++] = batch[--count];
+    }
+  }
+  for (int i = 0; i < count; ++i) {
+    domain.FreePhys(batch[i]);
+  }
+  return true;
+}
+
+void PageCache::Free(PhysAddr page) {
+  FreeBatch(&page, 1);
+}
+
+void PageCache::FreeBatch(const PhysAddr * pages, int count) {
+  AssertNoncritical();
+  anarch::Domain & domain = anarch::Domain::GetCurrent();
+  PhysAddr drained[BatchSize];
+  int drainedCount = 0;
+  int used = 0;
+  if (stacks) {
+    anarch::ScopedCritical critical;
+    Stack & stack = GetCurrentStack();
+    if (stack.count == Capacity && count) {
+      // give back the pages which were freed longest ago
+      drainedCount = BatchSize;
+      for (int i = 0; i < Capacity; ++i) {
+        if (i < BatchSize) {
+          drained[i] = stack.pages[i];
+        } else {
+          stack.pages[i - BatchSize] = stack.pages[i];
+        }
+      }
+      stack.count -= BatchSize;
+    }
+    while (used < count && stack.count < Capacity) {
+      stack.pages[stack.count++] = pages[used++];
+    }
+  }
+  for (int i = 0; i < drainedCount; ++i) {
+    domain.FreePhys(drained[i]);
+  }
+  for (int i = used; i < count; ++i) {
+    domain.FreePhys(pages[i]);
+  }
+}
+
+bool PageCache::Clear(PhysAddr page) {
+  AssertNoncritical();
+  anarch::GlobalMap & map = anarch::GlobalMap::GetGlobal();
+  anarch::MemoryMap::Size size(PageSize, 1);
+  anarch::MemoryMap::Attributes attrs;
+  attrs.executable = false;
+  VirtAddr addr;
+  if (!map.Map(addr, page, size, attrs)) return false;
+  ansa::Memset((void *)addr, 0, PageSize);
+  map.Unmap(addr, size);
+  return true;
+}
+
+bool PageCache::Copy(void * dest, PhysAddr page) {
+  AssertNoncritical();
+  anarch::GlobalMap & map = anarch::GlobalMap::GetGlobal();
+  anarch::MemoryMap::Size size(PageSize, 1);
+  anarch::MemoryMap::Attributes attrs;
+  attrs.executable = false;
+  attrs.writable = false;
+  VirtAddr addr;
+  if (!map.Map(addr, page, size, attrs)) return false;
+  ansa::Memcpy(dest, (void *)addr, PageSize);
+  map.Unmap(addr, size);
+  return true;
+}
+
+}
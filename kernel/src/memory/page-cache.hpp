@@ -0,0 +1,66 @@
+#ifndef __ALUX_PAGE_CACHE_HPP__
+#define __ALUX_PAGE_CACHE_HPP__
+
+#include <anarch/types>
+
+namespace Alux {
+
+/**
+ * Keeps a stack of free 4 KiB physical pages for every CPU, so that the
+ * fault path seldom takes the lock of the domain's page allocator.
+ *
+ * A CPU whose stack is empty takes [BatchSize] pages from its domain at once;
+ * a CPU whose stack is full gives half of it back the same way. The domain
+ * allocator is only ever called outside of critical sections.
+ */
+class PageCache {
+public:
+  static const int Capacity = 64;
+  static const int BatchSize = Capacity / 2;
+  static const PhysSize PageSize = 0x1000;
+  
+  /**
+   * Create the per-CPU stacks. Until this is called, pages come straight
+   * from the domain allocator.
+   * @noncritical
+   */
+  static void Initialize();
+  
+  /**
+   * Allocate a page aligned to [PageSize]. Returns `false` if the domain
+   * has run out of memory.
+   * @noncritical
+   */
+  static bool Alloc(PhysAddr & result);
+  
+  /**
+   * Free a page which was allocated with [Alloc].
+   * @noncritical
+   */
+  static void Free(PhysAddr page);
+  
+  /**
+   * Free many pages at once, such as when a map is torn down. Pages which do
+   * not fit on the current CPU's stack go straight back to the domain.
+   * @noncritical
+   */
+  static void FreeBatch(const PhysAddr * pages, int count);
+  
+  /**
+   * Clear a page through a temporary mapping in the global map. Returns
+   * `false` if the page could not be mapped.
+   * @noncritical
+   */
+  static bool Clear(PhysAddr page);
+  
+  /**
+   * Copy a page into [dest] through a temporary mapping in the global map.
+   * Returns `false` if the page could not be mapped.
+   * @noncritical
+   */
+  static bool Copy(void * dest, PhysAddr page);
+};
+
+}
+
+#endif
@@ -1,6 +1,7 @@
 #include "page-fault.hpp"
 #include "../tasks/hold-scope.hpp"
 #include "../tasks/user-task.hpp"
+#include <anarch/api/domain>
 #include <anarch/api/panic>
 
 #include <anarch/stream> // TODO: delete this
@@ -12,6 +13,12 @@ void HandlePageFault(VirtAddr addr, bool write) {
   if (scope.GetTask().IsUserTask()) {
     UserTask & task = static_cast<UserTask &>(scope.GetTask());
     if (task.GetExecutableMap().HandlePageFault(addr, write)) {
+      // a write fault gives the task a page from this CPU's domain
+      if (write) task.NoteMemoryDomain(anarch::Domain::GetCurrent());
+      return;
+    }
+    if (task.GetAnonymousMap().HandlePageFault(addr, write)) {
+      task.NoteMemoryDomain(anarch::Domain::GetCurrent());
       return;
     }
   }
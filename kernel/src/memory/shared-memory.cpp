@@ -0,0 +1,152 @@
+#include "shared-memory.hpp"
+#include <anarch/api/global-map>
+#include <anarch/critical>
+#include <ansa/cstring>
+
+namespace Alux {
+
+namespace {
+
+bool Clear(PhysAddr start, size_t pageCount) {
+  anarch::GlobalMap & map = anarch::GlobalMap::GetGlobal();
+  anarch::MemoryMap::Size size(SharedMemory::PageSize, pageCount);
+  anarch::MemoryMap::Attributes attrs;
+  attrs.executable = false;
+  VirtAddr addr;
+  if (!map.Map(addr, start, size, attrs)) return false;
+  ansa::Memset((void *)addr, 0, SharedMemory::PageSize * pageCount);
+  map.Unmap(addr, size);
+  return true;
+}
+
+}
+
+SharedMemory * SharedMemory::New(size_t pageCount) {
+  AssertNoncritical();
+  if (!pageCount || pageCount > MaxPageCount) return NULL;
+  anarch::Domain & domain = anarch::Domain::GetCurrent();
+  PhysAddr start;
+  if (!domain.AllocPhys(start, PageSize * pageCount, PageSize)) {
+    return NULL;
+  }
+  // the pages may still hold another task's data
+  if (!Clear(start, pageCount)) {
+    domain.FreePhys(start);
+    return NULL;
+  }
+  SharedMemory * res = new SharedMemory(domain, start, pageCount);
+  assert(res != NULL);
+  return res;
+}
+
+void SharedMemory::Retain() {
+  ++refCount;
+}
+
+void SharedMemory::Release() {
+  AssertNoncritical();
+  if (--refCount) return;
+  domain.FreePhys(physicalAddr);
+  delete this;
+}
+
+SharedMemory::SharedMemory(anarch::Domain & d, PhysAddr p, size_t c)
+  : domain(d), physicalAddr(p), pageCount(c), refCount(1) {
+}
+
+SharedMemoryTable::~SharedMemoryTable() {
+  AssertNoncritical();
+  for (int i = 0; i < Capacity; ++i) {
+    if (entries[i].memory) entries[i].memory->Release();
+  }
+}
+
+int SharedMemoryTable::Add(SharedMemory & memory) {
+  AssertNoncritical();
+  anarch::ScopedLock scope(lock);
+  for (int i = 0; i < Capacity; ++i) {
+    if (entries[i].memory) continue;
+    memory.Retain();
+    entries[i].memory = &memory;
+    entries[i].mapping = 0;
+    return i;
+  }
+  return -1;
+}
+
+SharedMemory * SharedMemoryTable::Get(int handle) {
+  AssertNoncritical();
+  if (handle < 0 || handle >= Capacity) return NULL;
+  anarch::ScopedLock scope(lock);
+  SharedMemory * memory = entries[handle].memory;
+  if (memory) memory->Retain();
+  return memory;
+}
+
+bool SharedMemoryTable::Map(int handle, anarch::UserMap & map, bool writable,
+                            VirtAddr & result) {
+  AssertNoncritical();
+  if (handle < 0 || handle >= Capacity) return false;
+  anarch::ScopedLock scope(lock);
+  Entry & entry = entries[handle];
+  if (!entry.memory) return false;
+  if (entry.mapping && entry.writable == writable) {
+    result = entry.mapping;
+    return true;
+  }
+  
+  anarch::MemoryMap::Size size(SharedMemory::PageSize,
+                               entry.memory->GetPageCount());
+  anarch::MemoryMap::Attributes attrs;
+  attrs.executable = false;
+  attrs.writable = writable;
+  PhysAddr physical = entry.memory->GetPhysicalAddress();
+  if (entry.mapping) {
+    // keep the address, which other threads of the task may be using
+    map.UnmapAndReserve(entry.mapping, size);
+    map.MapAt(entry.mapping, physical, size, attrs);
+  } else {
+    VirtAddr addr;
+    if (!map.Map(addr, physical, size, attrs)) return false;
+    entry.mapping = addr;
+  }
+  entry.writable = writable;
+  result = entry.mapping;
+  return true;
+}
+
+bool SharedMemoryTable::Unmap(int handle, anarch::UserMap & map) {
+  AssertNoncritical();
+  if (handle < 0 || handle >= Capacity) return false;
+  anarch::ScopedLock scope(lock);
+  Entry & entry = entries[handle];
+  if (!entry.memory) return false;
+  UnmapEntry(entry, map);
+  return true;
+}
+
+bool SharedMemoryTable::Remove(int handle, anarch::UserMap & map) {
+  AssertNoncritical();
+  if (handle < 0 || handle >= Capacity) return false;
+  SharedMemory * memory;
+  {
+    anarch::ScopedLock scope(lock);
+    Entry & entry = entries[handle];
+    if (!entry.memory) return false;
+    UnmapEntry(entry, map);
+    memory = entry.memory;
+    entry.memory = NULL;
+  }
+  memory->Release();
+  return true;
+}
+
+void SharedMemoryTable::UnmapEntry(Entry & entry, anarch::UserMap & map) {
+  if (!entry.mapping) return;
+  anarch::MemoryMap::Size size(SharedMemory::PageSize,
+                               entry.memory->GetPageCount());
+  map.Unmap(entry.mapping, size);
+  entry.mapping = 0;
+}
+
+}
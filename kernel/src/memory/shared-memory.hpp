@@ -0,0 +1,123 @@
+#ifndef __ALUX_SHARED_MEMORY_HPP__
+#define __ALUX_SHARED_MEMORY_HPP__
+
+#include <anarch/lock>
+#include <anarch/api/user-map>
+#include <anarch/api/domain>
+#include <ansa/atomic>
+
+namespace Alux {
+
+/**
+ * A physically contiguous run of zeroed 4 KiB pages which any number of user
+ * tasks may map at once. The pages come straight from the domain allocator
+ * and are given back when the last reference to the object is released.
+ */
+class SharedMemory {
+public:
+  static const PhysSize PageSize = 0x1000;
+  static const size_t MaxPageCount = 0x4000;
+  
+  /**
+   * Allocate and clear [pageCount] pages. The result has one reference.
+   * Returns NULL if [pageCount] is out of range or there is no memory left.
+   * @noncritical
+   */
+  static SharedMemory * New(size_t pageCount);
+  
+  /**
+   * Add a reference.
+   * @ambicritical
+   */
+  void Retain();
+  
+  /**
+   * Drop a reference, freeing the pages and the object if it was the last.
+   * @noncritical
+   */
+  void Release();
+  
+  inline PhysAddr GetPhysicalAddress() {
+    return physicalAddr;
+  }
+  
+  inline size_t GetPageCount() {
+    return pageCount;
+  }
+  
+private:
+  SharedMemory(anarch::Domain &, PhysAddr, size_t);
+  
+  anarch::Domain & domain;
+  PhysAddr physicalAddr;
+  size_t pageCount;
+  ansa::Atomic<int> refCount;
+};
+
+/**
+ * The shared memory handles of a [UserTask]. A handle is an index into the
+ * table; each one holds a reference to its [SharedMemory] and remembers
+ * where, if anywhere, the task has mapped it.
+ *
+ * Destroying the table drops every reference without unmapping anything, so
+ * it should only happen after the task's memory map is gone.
+ */
+class SharedMemoryTable {
+public:
+  static const int Capacity = 16;
+  
+  ~SharedMemoryTable(); // @noncritical
+  
+  /**
+   * Retain [memory] and give it a handle. Returns -1 if the table is full.
+   * @noncritical
+   */
+  int Add(SharedMemory & memory);
+  
+  /**
+   * Return the object behind [handle], retained, or NULL if the handle is
+   * not in use.
+   * @noncritical
+   */
+  SharedMemory * Get(int handle);
+  
+  /**
+   * Map the object behind [handle] into [map]. If it is already mapped, its
+   * existing address is returned, and the pages are remapped in place if
+   * [writable] differs from how they were mapped. Returns `false` if the
+   * handle is not in use or there is no room for the mapping.
+   * @noncritical
+   */
+  bool Map(int handle, anarch::UserMap & map, bool writable,
+           VirtAddr & result);
+  
+  /**
+   * Unmap the object behind [handle] from [map], if it is mapped. Returns
+   * `false` if the handle is not in use.
+   * @noncritical
+   */
+  bool Unmap(int handle, anarch::UserMap & map);
+  
+  /**
+   * Unmap the object behind [handle] and release the handle. Returns `false`
+   * if the handle is not in use.
+   * @noncritical
+   */
+  bool Remove(int handle, anarch::UserMap & map);
+  
+private:
+  struct Entry {
+    SharedMemory * memory = NULL;
+    VirtAddr mapping = 0;
+    bool writable = false; // how [mapping] is mapped
+  };
+  
+  anarch::NoncriticalLock lock;
+  Entry entries[Capacity];
+  
+  void UnmapEntry(Entry &, anarch::UserMap &);
+};
+
+}
+
+#endif
@@ -0,0 +1,178 @@
+#include "zero-pool.hpp"
+#include "page-cache.hpp"
+#include "../scheduler/scheduler.hpp"
+#include <anarch/api/domain-list>
+#include <anarch/api/state>
+#include <anarch/api/panic>
+#include <anarch/critical>
+#include <ansa/atomic>
+
+namespace Alux {
+
+namespace {
+
+struct Pool {
+  anarch::Domain * domain = NULL;
+  uint64_t mask = 0; // the CPUs of [domain], for the thread's affinity
+  Scheduler * scheduler = NULL;
+  Thread * thread = NULL;
+  
+  // [lock] protects [pages]; [count] is only changed with it held
+  anarch::CriticalLock lock;
+  PhysAddr pages[ZeroPool::Capacity];
+  ansa::Atomic<int> count;
+  
+  // [awake] is only set to `false` by the pool's thread, with [wakeLock]
+  // held, right before it sleeps
+  anarch::CriticalLock wakeLock;
+  ansa::Atomic<bool> awake;
+};
+
+Pool * pools;
+int poolCount;
+
+Pool & GetPool(anarch::Domain & domain) {
+  for (int i = 0; i < poolCount; ++i) {
+    if (pools[i].domain == &domain) return pools[i];
+  }
+  anarch::Panic("ZeroPool - unknown domain");
+}
+
+void Wake(Pool & pool) {
+  AssertCritical();
+  if (pool.awake) return;
+  anarch::ScopedLock scope(pool.wakeLock);
+  if (pool.awake) return;
+  pool.awake = true;
+  if (pool.thread) pool.scheduler->ClearTimeout(*pool.thread);
+}
+
+// returns `false` if it ran out of memory before the pool was full
+bool Fill(Pool & pool) {
+  AssertNoncritical();
+  while (pool.count < ZeroPool::Capacity) {
+    PhysAddr page;
+    if (!PageCache::Alloc(page)) return false;
+    if (!PageCache::Clear(page)) {
+      PageCache::Free(page);
+      return false;
+    }
+    bool kept = false;
+    {
+      anarch::ScopedCritical critical;
+      anarch::ScopedLock scope(pool.lock);
+      if (pool.count < ZeroPool::Capacity) {
+        pool.pages[pool.count++] = page;
+        kept = true;
+      }
+    }
+    if (!kept) PageCache::Free(page);
+  }
+  return true;
+}
+
+void RunPool(void * poolPtr) {
+  AssertNoncritical();
+  Pool & pool = *(Pool *)poolPtr;
+  while (1) {
+    bool starved = !Fill(pool);
+    
+    anarch::SetCritical(true);
+    pool.wakeLock.Seize();
+    pool.awake = false;
+    if (!starved && pool.count < ZeroPool::LowWater) {
+      // pages were taken after we looked; their takers saw us awake
+      pool.awake = true;
+      pool.wakeLock.Release();
+    } else {
+      // a starved pool tries again once somebody takes a page, rather than
+      // competing with every other allocation for what is left
+      pool.scheduler->SetInfiniteTimeout(pool.wakeLock);
+    }
+    anarch::SetCritical(false);
+  }
+}
+
+}
+
+void ZeroPool::Initialize() {
+  AssertNoncritical();
+  anarch::DomainList & domains = anarch::DomainList::GetGlobal();
+  Pool * list = new Pool[domains.GetCount()];
+  assert(list != NULL);
+  int firstCPU = 0;
+  for (int i = 0; i < domains.GetCount(); ++i) {
+    int cpuCount = domains[i].GetThreadCount();
+    list[i].domain = &domains[i];
+    list[i].count = 0;
+    list[i].awake = false;
+    list[i].mask = 0xffffffffffffffffUL;
+    if (firstCPU + cpuCount < 64) {
+      list[i].mask = (((uint64_t)1 << cpuCount) - 1) << firstCPU;
+    }
+    firstCPU += cpuCount;
+  }
+  poolCount = domains.GetCount();
+  pools = list;
+}
+
+void ZeroPool::Start(Task & task) {
+  AssertNoncritical();
+  Scheduler & scheduler = task.GetScheduler();
+  for (int i = 0; i < poolCount; ++i) {
+    Pool & pool = pools[i];
+    pool.scheduler = &scheduler;
+    anarch::State & state = anarch::State::NewKernel(RunPool, (void *)&pool);
+    task.Retain();
+    Thread & thread = Thread::New(task, state);
+    if (!thread.AddToTask()) {
+      anarch::Panic("ZeroPool::Start() - failed to add thread to task");
+    }
+    thread.AddToScheduler();
+    
+    // clear pages next to the CPUs that will use them, and only when those
+    // CPUs have nothing else to run; a scheduler without an idle class can
+    // at least run the thread at its lowest priority
+    scheduler.SetAffinity(thread, pool.mask);
+    if (!scheduler.SetIdleClass(thread, true) &&
+        scheduler.GetPriorityCount()) {
+      scheduler.SetPriority(thread, scheduler.GetPriorityCount() - 1);
+    }
+    
+    {
+      anarch::ScopedCritical critical;
+      anarch::ScopedLock scope(pool.wakeLock);
+      pool.thread = &thread;
+      pool.awake = true;
+      scheduler.ClearTimeout(thread);
+    }
+    thread.Release();
+  }
+}
+
+bool ZeroPool::Alloc(PhysAddr & page, bool & zeroed) {
+  AssertNoncritical();
+  if (pools) {
+    bool found = false;
+    {
+      anarch::ScopedCritical critical;
+      Pool & pool = GetPool(anarch::Domain::GetCurrent());
+      pool.lock.Seize();
+      if (pool.count) {
+        page = pool.pages[--pool.count];
+        found = true;
+      }
+      bool low = (pool.count < LowWater);
+      pool.lock.Release();
+      if (low) Wake(pool);
+    }
+    if (found) {
+      zeroed = true;
+      return true;
+    }
+  }
+  zeroed = false;
+  return PageCache::Alloc(page);
+}
+
+}
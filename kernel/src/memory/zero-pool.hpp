@@ -0,0 +1,52 @@
+#ifndef __ALUX_ZERO_POOL_HPP__
+#define __ALUX_ZERO_POOL_HPP__
+
+#include <anarch/types>
+
+namespace Alux {
+
+class Task;
+
+/**
+ * Keeps a pool of 4 KiB physical pages which have already been zeroed, so
+ * that a fault which needs a blank page does not have to clear one first.
+ *
+ * Every [anarch::Domain] has its own pool and its own kernel thread, which
+ * is put in the scheduler's idle class so that it only clears pages while
+ * the domain's CPUs have nothing else to run. A scheduler without an idle
+ * class runs it at its lowest priority instead, where it still competes with
+ * other threads of that priority. The thread fills its pool up
+ * to [Capacity] pages and then sleeps until taking pages leaves fewer than
+ * [LowWater] in the pool.
+ */
+class ZeroPool {
+public:
+  static const int Capacity = 256;
+  static const int LowWater = 64;
+  
+  /**
+   * Create the pools. Until this is called, every page must be zeroed by
+   * whoever allocates it.
+   * @noncritical
+   */
+  static void Initialize();
+  
+  /**
+   * Create a thread in [task] for every pool.
+   * @noncritical
+   */
+  static void Start(Task & task);
+  
+  /**
+   * Allocate a page, preferably from the current domain's pool. [zeroed] is
+   * set to `false` if the pool was empty and the caller has to clear the page
+   * itself. Returns `false` if there is no memory left. The page can be freed
+   * with [PageCache::Free].
+   * @noncritical
+   */
+  static bool Alloc(PhysAddr & page, bool & zeroed);
+};
+
+}
+
+#endif
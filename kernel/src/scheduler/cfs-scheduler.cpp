@@ -0,0 +1,181 @@
+#include "cfs-scheduler.hpp"
+#include <anarch/critical>
+
+namespace Alux {
+
+namespace {
+
+// the weight for each priority; every step is worth about 25% of CPU time
+const uint64_t priorityWeights[CFSScheduler::PriorityCount] = {
+  88761, 71755, 56483, 46273, 36291, 29154, 23254, 18705, 14949, 11916,
+  9548, 7620, 6100, 4904, 3906, 3121, 2501, 1991, 1586, 1277,
+  1024, 820, 655, 526, 423, 335, 272, 215, 172, 137,
+  110, 87, 70, 56, 45, 36, 29, 23, 18, 15
+};
+
+}
+
+CFSScheduler::CFSScheduler(Fairness f) : fairness(f) {
+  Initialize();
+}
+
+bool CFSScheduler::SetPriority(Thread & th, int priority) {
+  AssertNoncritical();
+  if (priority < 0 || priority >= PriorityCount) return false;
+  if (!ThreadUserInfo(th)) return false; // not scheduled yet
+  
+  anarch::ScopedCritical critical;
+  CFSThreadObj & obj = static_cast<CFSThreadObj &>(GetThreadObj(th));
+  uint64_t now = GetNow();
+  CPU & cpu = SeizeThreadCPU(obj);
+  
+  // a queued thread is requeued so that its queue's total weight is right
+  bool queued = (obj.state == ThreadObj::StateReady && !obj.runtime &&
+                 !obj.idleClass);
+  if (queued) cpu.queue->Remove(obj);
+  obj.weight = GetWeight(priority);
+  if (queued) cpu.queue->Push(obj, now);
+  
+  cpu.lock.Release();
+  return true;
+}
+
+int CFSScheduler::GetPriorityCount() {
+  return PriorityCount;
+}
+
+int CFSScheduler::GetDefaultPriority() {
+  return DefaultPriority;
+}
+
+QueueScheduler::ThreadObj & CFSScheduler::NewThreadObj(Thread & th) {
+  static_assert(sizeof(CFSThreadObj) <= MaxThreadObjSize,
+                "CFSThreadObj does not fit in the ThreadObj cache");
+  CFSThreadObj * obj = new CFSThreadObj(th, fairness == FairnessPerTask);
+  assert(obj != NULL);
+  return *obj;
+}
+
+QueueScheduler::RunQueue & CFSScheduler::NewRunQueue() {
+  CFSRunQueue * queue = new CFSRunQueue();
+  assert(queue != NULL);
+  return *queue;
+}
+
+uint64_t CFSScheduler::GetWeight(int priority) {
+  return priorityWeights[priority];
+}
+
+uint64_t CFSScheduler::ScaleRuntime(CFSThreadObj & obj, uint64_t ran) {
+  uint64_t scaled = ran * GetWeight(DefaultPriority) / obj.weight;
+  if (obj.perTask) {
+    int threads = TaskThreadCount(obj.thread.GetTask());
+    if (threads > 1) scaled *= (uint64_t)threads;
+  }
+  return scaled;
+}
+
+bool CFSScheduler::IsBefore(uint64_t a, uint64_t b) {
+  return (int64_t)(a - b) < 0;
+}
+
+bool CFSScheduler::HasLessVruntime(const CFSThreadObj & a,
+                                   const CFSThreadObj & b) {
+  return IsBefore(a.vruntime, b.vruntime);
+}
+
+CFSScheduler::CFSThreadObj::CFSThreadObj(Thread & t, bool task)
+  : ThreadObj(t), link(*this), weight(GetWeight(DefaultPriority)),
+    perTask(task) {
+  if (perTask) ++TaskThreadCount(thread.GetTask());
+}
+
+CFSScheduler::CFSThreadObj::~CFSThreadObj() {
+  if (perTask) --TaskThreadCount(thread.GetTask());
+}
+
+void CFSScheduler::CFSRunQueue::Push(ThreadObj & anObj, uint64_t) {
+  CFSThreadObj & obj = static_cast<CFSThreadObj &>(anObj);
+  Adopt(obj);
+  
+  // a thread that slept may not bank more than half a latency period
+  uint64_t floor = minVruntime - MicrosToTicks(TargetLatencyUs / 2);
+  if (IsBefore(obj.vruntime, floor)) obj.vruntime = floor;
+  
+  threads.Add(&obj.link);
+  ++count;
+  totalWeight += obj.weight;
+}
+
+QueueScheduler::ThreadObj * CFSScheduler::CFSRunQueue::Shift(uint64_t) {
+  CFSThreadObj * obj = threads.Shift();
+  if (!obj) return NULL;
+  --count;
+  totalWeight -= obj->weight;
+  return obj;
+}
+
+QueueScheduler::ThreadObj * CFSScheduler::CFSRunQueue::GetFirst() {
+  return threads.GetFirst();
+}
+
+void CFSScheduler::CFSRunQueue::Remove(ThreadObj & anObj) {
+  CFSThreadObj & obj = static_cast<CFSThreadObj &>(anObj);
+  threads.Remove(&obj.link);
+  --count;
+  totalWeight -= obj.weight;
+}
+
+void CFSScheduler::CFSRunQueue::Charge(ThreadObj & anObj, uint64_t ran,
+                                       bool) {
+  CFSThreadObj & obj = static_cast<CFSThreadObj &>(anObj);
+  Adopt(obj);
+  obj.vruntime += ScaleRuntime(obj, ran);
+  
+  CFSThreadObj * first = threads.GetFirst();
+  if (first && IsBefore(first->vruntime, obj.vruntime)) {
+    UpdateMin(first->vruntime);
+  } else {
+    UpdateMin(obj.vruntime);
+  }
+}
+
+uint64_t CFSScheduler::CFSRunQueue::GetSlice(ThreadObj & current) {
+  // every runnable thread gets a turn within the period, which only grows
+  // past the target latency when the slices would get too short
+  CFSThreadObj & obj = static_cast<CFSThreadObj &>(current);
+  if (obj.quantum) return AdaptSlice(obj.quantum, count);
+  uint64_t period = TargetLatencyUs;
+  uint64_t minPeriod = (uint64_t)(count + 1) * MinGranularityUs;
+  if (minPeriod > period) period = minPeriod;
+  uint64_t slice = period * obj.weight / (totalWeight + obj.weight);
+  if (slice < MinGranularityUs) slice = MinGranularityUs;
+  return MicrosToTicks(slice);
+}
+
+bool CFSScheduler::CFSRunQueue::ShouldPreempt(ThreadObj & current,
+                                              ThreadObj & woken,
+                                              uint64_t ran) {
+  CFSThreadObj & obj = static_cast<CFSThreadObj &>(current);
+  Adopt(obj);
+  uint64_t vruntime = obj.vruntime + ScaleRuntime(obj, ran);
+  uint64_t granularity = MicrosToTicks(WakeupGranularityUs);
+  return IsBefore(static_cast<CFSThreadObj &>(woken).vruntime + granularity,
+                  vruntime);
+}
+
+void CFSScheduler::CFSRunQueue::Adopt(CFSThreadObj & obj) {
+  if (obj.queue == this) return;
+  if (obj.queue) {
+    obj.vruntime = obj.vruntime - obj.queue->minVruntime + minVruntime;
+  } else {
+    obj.vruntime = minVruntime;
+  }
+  obj.queue = this;
+}
+
+void CFSScheduler::CFSRunQueue::UpdateMin(uint64_t candidate) {
+  if (IsBefore(minVruntime, candidate)) minVruntime = candidate;
+}
+
+}
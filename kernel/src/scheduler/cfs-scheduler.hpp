@@ -0,0 +1,104 @@
+#ifndef __ALUX_CFS_SCHEDULER_HPP__
+#define __ALUX_CFS_SCHEDULER_HPP__
+
+#include "queue-scheduler.hpp"
+#include "../containers/pairing-heap.hpp"
+
+namespace Alux {
+
+/**
+ * A fair-share scheduler. Every thread accumulates a virtual runtime, which
+ * is the CPU time it has used scaled down by its weight, and each CPU always
+ * runs the thread with the smallest virtual runtime next.
+ *
+ * A thread's weight comes from its priority, which works like a nice value:
+ * priority 20 is the default, and each step away from it changes the weight
+ * by about 25%. The time slice is a thread's share of [TargetLatencyUs], so
+ * it shrinks as more threads wait, but never below [MinGranularityUs]. A
+ * thread with its own quantum gets that instead.
+ *
+ * With [FairnessPerTask], a thread's virtual runtime also grows in
+ * proportion to the number of threads in its task, so a task cannot get
+ * more of the CPU by spawning more threads.
+ */
+class CFSScheduler : public QueueScheduler {
+public:
+  enum Fairness {
+    FairnessPerThread,
+    FairnessPerTask
+  };
+  
+  static const int PriorityCount = 40;
+  static const int DefaultPriority = 20;
+  static const uint64_t TargetLatencyUs = 20000;
+  static const uint64_t MinGranularityUs = 4000;
+  static const uint64_t WakeupGranularityUs = 1000;
+  
+  CFSScheduler(Fairness = FairnessPerTask); // @noncritical
+  
+  virtual bool SetPriority(Thread &, int priority);
+  virtual int GetPriorityCount();
+  virtual int GetDefaultPriority();
+  
+protected:
+  virtual ThreadObj & NewThreadObj(Thread &);
+  virtual RunQueue & NewRunQueue();
+  
+private:
+  struct CFSThreadObj;
+  class CFSRunQueue;
+  
+  static bool HasLessVruntime(const CFSThreadObj &, const CFSThreadObj &);
+  
+  typedef PairingHeap<CFSThreadObj, HasLessVruntime> VruntimeHeap;
+  
+  struct CFSThreadObj : public ThreadObj {
+    CFSThreadObj(Thread & t, bool perTask); // @noncritical
+    virtual ~CFSThreadObj(); // @noncritical
+    
+    VruntimeHeap::Link link;
+    
+    // [vruntime] is measured against the [minVruntime] of [queue], which is
+    // the queue of the CPU that last ran the thread or NULL for a new thread
+    CFSRunQueue * queue = NULL;
+    uint64_t vruntime = 0;
+    uint64_t weight;
+    bool perTask;
+  };
+  
+  class CFSRunQueue : public RunQueue {
+  public:
+    virtual void Push(ThreadObj &, uint64_t now);
+    virtual ThreadObj * Shift(uint64_t now);
+    virtual ThreadObj * GetFirst();
+    virtual void Remove(ThreadObj &);
+    virtual void Charge(ThreadObj &, uint64_t ran, bool blocked);
+    virtual uint64_t GetSlice(ThreadObj & current);
+    virtual bool ShouldPreempt(ThreadObj & current, ThreadObj & woken,
+                               uint64_t ran);
+  
+  private:
+    friend class CFSScheduler;
+    
+    VruntimeHeap threads;
+    int count = 0;
+    uint64_t totalWeight = 0;
+    
+    // only grows, so that a thread's vruntime can be carried between CPUs
+    // by measuring it against the minimum of its old and new queues
+    ansa::Atomic<uint64_t> minVruntime;
+    
+    void Adopt(CFSThreadObj &);
+    void UpdateMin(uint64_t candidate);
+  };
+  
+  Fairness fairness;
+  
+  static uint64_t GetWeight(int priority); // @ambicritical
+  static uint64_t ScaleRuntime(CFSThreadObj &, uint64_t ran); // @ambicritical
+  static bool IsBefore(uint64_t a, uint64_t b); // @ambicritical
+};
+
+}
+
+#endif
@@ -1,35 +1,24 @@
 #include "garbage-collector.hpp"
-#include "scheduler.hpp"
 #include <anarch/critical>
 
 namespace Alux {
 
-GarbageCollector::GarbageCollector(Scheduler & s) : scheduler(s) {
+GarbageCollector::GarbageCollector(WorkQueue & q) : workQueue(q) {
 }
 
-void GarbageCollector::Main() {
+void GarbageCollector::ReduceBacklog() {
   AssertNoncritical();
-  while (1) {
-    anarch::SetCritical(true);
-    objectsLock.Seize();
-    GarbageObject * obj = objects.Shift();
-    if (!obj) {
-      scheduler.SetInfiniteTimeout(objectsLock);
-      anarch::SetCritical(false);
-    } else {
-      objectsLock.Release();
-      anarch::SetCritical(false);
-      obj->Dealloc();
-    }
-  }
+  workQueue.ReduceBacklog();
+}
+
+int GarbageCollector::GetPendingCount() {
+  return workQueue.GetPendingCount(WorkItem::PriorityBulk);
 }
 
 void GarbageCollector::Add(GarbageObject & obj) {
-  anarch::ScopedCritical critical;
-  objectsLock.Seize();
-  objects.Add(&obj.garbageLink);
-  scheduler.ClearGarbageTimeout();
-  objectsLock.Release();
+  bool queued = workQueue.Queue(obj.garbageItem);
+  assert(queued);
+  (void)queued;
 }
 
 }
@@ -2,18 +2,34 @@
 #define __ALUX_GARBAGE_COLLECTOR_HPP__
 
 #include "garbage-object.hpp"
-#include <ansa/linked-list>
-#include <anarch/lock>
+#include "work-queue.hpp"
 
 namespace Alux {
 
-class Scheduler;
-
+/**
+ * Deallocates objects which were thrown away from critical sections.
+ *
+ * Every [GarbageObject] embeds a [WorkItem], so throwing an object away just
+ * queues it on a [WorkQueue]. Objects are normally bulk work, which waits
+ * behind urgent items; an object whose deallocation tells somebody something
+ * (like a [Terminal] hanging up) may ask to be urgent instead.
+ */
 class GarbageCollector {
 public:
-  GarbageCollector(Scheduler &);
+  GarbageCollector(WorkQueue &); // @noncritical
+  
+  /**
+   * If the current CPU has too many objects waiting, deallocate them until it
+   * does not.
+   * @noncritical
+   */
+  void ReduceBacklog();
   
-  void Main(); // @noncritical
+  /**
+   * Return the number of bulk objects waiting to be deallocated.
+   * @ambicritical
+   */
+  int GetPendingCount();
   
 protected:
   friend class GarbageObject;
@@ -21,10 +37,7 @@ protected:
   void Add(GarbageObject &); // @ambicritical
   
 private:
-  Scheduler & scheduler;
-  
-  anarch::CriticalLock objectsLock;
-  ansa::LinkedList<GarbageObject> objects;
+  WorkQueue & workQueue;
 };
 
 }
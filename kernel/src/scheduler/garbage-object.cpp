@@ -7,11 +7,15 @@ void GarbageObject::ThrowAway() {
   collector.Add(*this);
 }
 
-GarbageObject::GarbageObject(GarbageCollector & c)
-  : garbageLink(*this), collector(c) {
+GarbageObject::GarbageObject(GarbageCollector & c, WorkItem::Priority p)
+  : garbageItem(CallDealloc, (void *)this, p), collector(c) {
 }
 
 GarbageObject::~GarbageObject() {  
 }
 
+void GarbageObject::CallDealloc(void * obj) {
+  ((GarbageObject *)obj)->Dealloc();
+}
+
 }
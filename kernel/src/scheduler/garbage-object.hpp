@@ -1,7 +1,7 @@
 #ifndef __ALUX_GARBAGE_OBJECT_HPP__
 #define __ALUX_GARBAGE_OBJECT_HPP__
 
-#include <ansa/linked-list>
+#include "work-item.hpp"
 
 namespace Alux {
 
@@ -22,14 +22,21 @@ public:
   virtual void Dealloc() = 0;
   
 protected:
-  GarbageObject(GarbageCollector &);
+  /**
+   * Thrown away objects are bulk work unless [priority] says otherwise.
+   * @ambicritical
+   */
+  GarbageObject(GarbageCollector &,
+                WorkItem::Priority priority = WorkItem::PriorityBulk);
   virtual ~GarbageObject();
   
   friend class GarbageCollector;
-  ansa::LinkedList<GarbageObject>::Link garbageLink;
+  WorkItem garbageItem;
   
 private:
   GarbageCollector & collector;
+  
+  static void CallDealloc(void * obj);
 };
 
 }
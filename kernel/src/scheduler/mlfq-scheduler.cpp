@@ -0,0 +1,154 @@
+#include "mlfq-scheduler.hpp"
+#include <anarch/critical>
+
+namespace Alux {
+
+MLFQScheduler::MLFQScheduler(uint64_t q) : quantumUs(q) {
+  Initialize();
+}
+
+bool MLFQScheduler::SetPriority(Thread & th, int priority) {
+  AssertNoncritical();
+  if (priority < 0 || priority >= LevelCount) return false;
+  if (!ThreadUserInfo(th)) return false; // not scheduled yet
+  
+  anarch::ScopedCritical critical;
+  MLFQThreadObj & obj = static_cast<MLFQThreadObj &>(GetThreadObj(th));
+  uint64_t now = GetNow();
+  CPU & cpu = SeizeThreadCPU(obj);
+  
+  // a queued thread has to be requeued on its new level; a running or
+  // sleeping thread picks up its new level the next time it is queued
+  bool queued = (obj.state == ThreadObj::StateReady && !obj.runtime &&
+                 !obj.idleClass);
+  if (queued) cpu.queue->Remove(obj);
+  obj.basePriority = priority;
+  obj.Reset(GetEpoch(now));
+  if (queued) cpu.queue->Push(obj, now);
+  
+  cpu.lock.Release();
+  return true;
+}
+
+int MLFQScheduler::GetPriorityCount() {
+  return LevelCount;
+}
+
+int MLFQScheduler::GetDefaultPriority() {
+  return DefaultPriority;
+}
+
+QueueScheduler::ThreadObj & MLFQScheduler::NewThreadObj(Thread & th) {
+  static_assert(sizeof(MLFQThreadObj) <= MaxThreadObjSize,
+                "MLFQThreadObj does not fit in the ThreadObj cache");
+  MLFQThreadObj * obj = new MLFQThreadObj(th);
+  assert(obj != NULL);
+  return *obj;
+}
+
+QueueScheduler::RunQueue & MLFQScheduler::NewRunQueue() {
+  MLFQRunQueue * queue = new MLFQRunQueue(quantumUs);
+  assert(queue != NULL);
+  return *queue;
+}
+
+uint64_t MLFQScheduler::GetEpoch(uint64_t now) {
+  return now / MicrosToTicks(AgingUs);
+}
+
+void MLFQScheduler::MLFQThreadObj::Reset(uint64_t anEpoch) {
+  level = basePriority;
+  used = 0;
+  epoch = anEpoch;
+}
+
+void MLFQScheduler::MLFQRunQueue::Push(ThreadObj & anObj, uint64_t now) {
+  MLFQThreadObj & obj = static_cast<MLFQThreadObj &>(anObj);
+  uint64_t nowEpoch = GetEpoch(now);
+  if (obj.epoch != nowEpoch) obj.Reset(nowEpoch);
+  levels[obj.level].Add(&obj.link);
+  ++counts[obj.level];
+}
+
+QueueScheduler::ThreadObj * MLFQScheduler::MLFQRunQueue::Shift(uint64_t now) {
+  uint64_t nowEpoch = GetEpoch(now);
+  if (epoch != nowEpoch) Age(nowEpoch);
+  for (int i = 0; i < LevelCount; ++i) {
+    if (!counts[i]) continue;
+    --counts[i];
+    return levels[i].Shift();
+  }
+  return NULL;
+}
+
+QueueScheduler::ThreadObj * MLFQScheduler::MLFQRunQueue::GetFirst() {
+  for (int i = 0; i < LevelCount; ++i) {
+    if (counts[i]) return &*levels[i].GetStart();
+  }
+  return NULL;
+}
+
+void MLFQScheduler::MLFQRunQueue::Remove(ThreadObj & anObj) {
+  MLFQThreadObj & obj = static_cast<MLFQThreadObj &>(anObj);
+  levels[obj.level].Remove(&obj.link);
+  --counts[obj.level];
+}
+
+void MLFQScheduler::MLFQRunQueue::Charge(ThreadObj & anObj, uint64_t ran,
+                                         bool blocked) {
+  MLFQThreadObj & obj = static_cast<MLFQThreadObj &>(anObj);
+  uint64_t quantum = GetQuantum(obj);
+  obj.used += ran;
+  if (obj.used >= quantum) {
+    if (obj.level < LevelCount - 1) ++obj.level;
+    obj.used = 0;
+  } else if (blocked && ran < quantum / 2 && obj.level > obj.basePriority) {
+    --obj.level;
+    obj.used = 0;
+  }
+}
+
+uint64_t MLFQScheduler::MLFQRunQueue::GetSlice(ThreadObj & anObj) {
+  MLFQThreadObj & obj = static_cast<MLFQThreadObj &>(anObj);
+  
+  // only threads on this level or above compete with this one
+  int waiting = 0;
+  for (int i = 0; i <= obj.level; ++i) {
+    waiting += counts[i];
+  }
+  // the quantum may have been cut below what the thread has already used
+  uint64_t quantum = GetQuantum(obj);
+  uint64_t left = (obj.used < quantum ? quantum - obj.used : 0);
+  return AdaptSlice(left, waiting);
+}
+
+bool MLFQScheduler::MLFQRunQueue::ShouldPreempt(ThreadObj & current,
+                                                ThreadObj & woken,
+                                                uint64_t) {
+  // threads on the same level take turns at the end of each slice
+  return static_cast<MLFQThreadObj &>(woken).level <
+    static_cast<MLFQThreadObj &>(current).level;
+}
+
+void MLFQScheduler::MLFQRunQueue::Age(uint64_t nowEpoch) {
+  // every thread goes back to its base priority, which is never below the
+  // level it is queued on now, so each list only needs to be visited once
+  epoch = nowEpoch;
+  for (int i = 1; i < LevelCount; ++i) {
+    for (int count = counts[i]; count > 0; --count) {
+      MLFQThreadObj * obj = levels[i].Shift();
+      --counts[i];
+      obj->Reset(nowEpoch);
+      levels[obj->level].Add(&obj->link);
+      ++counts[obj->level];
+    }
+  }
+}
+
+uint64_t MLFQScheduler::MLFQRunQueue::GetQuantum(MLFQThreadObj & obj) {
+  uint64_t quantum = obj.quantum;
+  if (!quantum) quantum = MicrosToTicks(quantumUs);
+  return quantum << obj.level;
+}
+
+}
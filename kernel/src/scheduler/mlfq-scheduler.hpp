@@ -0,0 +1,86 @@
+#ifndef __ALUX_MLFQ_SCHEDULER_HPP__
+#define __ALUX_MLFQ_SCHEDULER_HPP__
+
+#include "queue-scheduler.hpp"
+#include <ansa/linked-list>
+
+namespace Alux {
+
+/**
+ * A multilevel feedback queue scheduler. Every CPU has [LevelCount] FIFO
+ * queues, and the first non-empty queue always runs first. Level 0 is the
+ * most urgent.
+ *
+ * A thread's quantum doubles with every level, starting at its own quantum
+ * or the scheduler's, which is chosen at boot and defaults to
+ * [DefaultQuantumUs]. The slice is shorter while many threads wait. A
+ * thread that uses up its quantum moves down a level, while a thread that
+ * blocks before using half of it moves back up toward its base priority. The
+ * quantum is charged across runs, so a thread cannot stay on a high level by
+ * yielding just before the quantum runs out.
+ *
+ * Every [AgingUs], each thread is put back on its base priority so that CPU
+ * bound threads cannot be starved.
+ */
+class MLFQScheduler : public QueueScheduler {
+public:
+  static const int LevelCount = 8;
+  static const int DefaultPriority = 2;
+  static const uint64_t DefaultQuantumUs = 5000;
+  static const uint64_t AgingUs = 1000000;
+  
+  MLFQScheduler(uint64_t quantumUs = DefaultQuantumUs); // @noncritical
+  
+  virtual bool SetPriority(Thread &, int priority);
+  virtual int GetPriorityCount();
+  virtual int GetDefaultPriority();
+  
+protected:
+  virtual ThreadObj & NewThreadObj(Thread &);
+  virtual RunQueue & NewRunQueue();
+  
+private:
+  struct MLFQThreadObj : public ThreadObj {
+    inline MLFQThreadObj(Thread & t) : ThreadObj(t), link(*this) {}
+    
+    ansa::LinkedList<MLFQThreadObj>::Link link;
+    
+    int basePriority = DefaultPriority;
+    int level = DefaultPriority;
+    uint64_t used = 0; // ticks of the quantum used on [level]
+    uint64_t epoch = 0; // the aging period in which [level] was set
+    
+    void Reset(uint64_t epoch); // move back to the base priority
+  };
+  
+  class MLFQRunQueue : public RunQueue {
+  public:
+    inline MLFQRunQueue(uint64_t q) : quantumUs(q) {}
+    
+    virtual void Push(ThreadObj &, uint64_t now);
+    virtual ThreadObj * Shift(uint64_t now);
+    virtual ThreadObj * GetFirst();
+    virtual void Remove(ThreadObj &);
+    virtual void Charge(ThreadObj &, uint64_t ran, bool blocked);
+    virtual uint64_t GetSlice(ThreadObj & current);
+    virtual bool ShouldPreempt(ThreadObj & current, ThreadObj & woken,
+                               uint64_t ran);
+  
+  private:
+    ansa::LinkedList<MLFQThreadObj> levels[LevelCount];
+    int counts[LevelCount] = {0};
+    uint64_t epoch = 0;
+    uint64_t quantumUs;
+    
+    void Age(uint64_t epoch);
+    uint64_t GetQuantum(MLFQThreadObj &); // the quantum on its level
+  };
+  
+  uint64_t quantumUs;
+  
+  static uint64_t GetEpoch(uint64_t now); // @ambicritical
+};
+
+}
+
+#endif
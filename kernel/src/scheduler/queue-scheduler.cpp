@@ -0,0 +1,1130 @@
+#include "queue-scheduler.hpp"
+#include "../memory/object-cache.hpp"
+#include <anarch/api/panic>
+#include <anarch/api/clock>
+#include <anarch/api/timer>
+#include <anarch/api/thread>
+#include <anarch/api/global-map>
+#include <anarch/api/domain-list>
+#include <anarch/api/clock-module>
+#include <anarch/critical>
+
+namespace Alux {
+
+const uint64_t QueueScheduler::InfiniteDeadline;
+
+QueueScheduler::QueueScheduler()
+  : tracing(false), workQueue(*this), collector(workQueue) {
+  // find every CPU; the run queues are created by Initialize()
+  anarch::DomainList & domains = anarch::DomainList::GetGlobal();
+  cpuCount = 0;
+  for (int i = 0; i < domains.GetCount(); ++i) {
+    cpuCount += domains[i].GetThreadCount();
+  }
+  cpus = new CPU[cpuCount];
+  assert(cpus != NULL);
+  groups = new TaskGroup[MaxTaskGroups];
+  assert(groups != NULL);
+  CPU * cpu = cpus;
+  for (int i = 0; i < domains.GetCount(); ++i) {
+    anarch::Domain & domain = domains[i];
+    for (int j = 0; j < domain.GetThreadCount(); ++j) {
+      cpu->thread = &domain.GetThread(j);
+      cpu->domain = &domain;
+      cpu->index = (int)(cpu - cpus);
+      cpu->nextDeadline = InfiniteDeadline;
+      ++cpu;
+    }
+  }
+}
+
+QueueScheduler::~QueueScheduler() {
+  for (int i = 0; i < cpuCount; ++i) {
+    delete cpus[i].queue;
+  }
+  delete[] cpus;
+  delete[] groups;
+}
+
+void QueueScheduler::Initialize() {
+  for (int i = 0; i < cpuCount; ++i) {
+    cpus[i].queue = &NewRunQueue();
+  }
+  
+  // create task
+  workerTask = &KernelTask::New(*this);
+  if (!workerTask->AddToScheduler()) {
+    anarch::Panic("QueueScheduler::Initialize() - failed to add task to "
+                  "scheduler");
+  }
+  
+  // create a worker thread for every CPU, then release the task
+  workQueue.Start(*workerTask);
+  workerTask->Unhold();
+}
+
+void QueueScheduler::Add(Thread & t) {
+  ThreadObj * obj = &NewThreadObj(t);
+  ThreadUserInfo(t) = (void *)obj;
+  
+  anarch::ScopedCritical critical;
+  uint64_t now = GetNow();
+  CPU * cpu = &PlaceThread(*obj, NULL);
+  cpu->lock.Seize();
+  obj->cpu = cpu;
+  Enqueue(*cpu, *obj, now);
+}
+
+void QueueScheduler::Remove(Thread & t) {
+  ThreadObj * obj = &GetThreadObj(t);
+  {
+    anarch::ScopedCritical critical;
+    while (1) {
+      CPU & cpu = SeizeThreadCPU(*obj);
+      if (obj->state == ThreadObj::StateMoving) {
+        // the thread is being moved or a CPU is trying to retain it
+        cpu.lock.Release();
+        continue;
+      }
+      assert(obj->state != ThreadObj::StateRunning);
+      if (obj->state == ThreadObj::StateReady) {
+        RemoveReady(cpu, *obj);
+      } else if (obj->state == ThreadObj::StateSleeping) {
+        RemoveSleeping(cpu, *obj);
+      }
+      cpu.lock.Release();
+      break;
+    }
+    
+    // give back the thread's share of its CPU
+    if (obj->bound) {
+      anarch::ScopedLock scope(realtimeLock);
+      obj->bound->realtimeDensity -= obj->density;
+    }
+  }
+  delete obj;
+}
+
+void * QueueScheduler::ThreadObj::operator new(size_t size) {
+  ObjectCache & cache = ObjectCache::GetGlobal(ObjectCache::KindThreadObj);
+  return cache.Alloc(size);
+}
+
+void QueueScheduler::ThreadObj::operator delete(void * ptr, size_t size) {
+  ObjectCache::Release(ptr, size);
+}
+
+void QueueScheduler::SetTimeout(uint64_t deadline) {
+  anarch::ScopedCritical critical;
+  Thread * th = Thread::GetCurrent();
+  assert(th != NULL);
+  ThreadObj * obj = &GetThreadObj(*th);
+  CPU & cpu = SeizeThreadCPU(*obj);
+  obj->deadline = deadline;
+  cpu.lock.Release();
+  Trace(TraceEvent::TypeTimeout, obj);
+  Yield();
+}
+
+void QueueScheduler::SetTimeout(uint64_t deadline, ansa::Lock & unlock) {
+  anarch::ScopedCritical critical;
+  Thread * th = Thread::GetCurrent();
+  assert(th != NULL);
+  ThreadObj * obj = &GetThreadObj(*th);
+  CPU & cpu = SeizeThreadCPU(*obj);
+  obj->deadline = deadline;
+  cpu.lock.Release();
+  unlock.Release();
+  Trace(TraceEvent::TypeTimeout, obj);
+  Yield();
+}
+
+void QueueScheduler::SetInfiniteTimeout() {
+  SetTimeout(InfiniteDeadline);
+}
+
+void QueueScheduler::SetInfiniteTimeout(ansa::Lock & unlock) {
+  SetTimeout(InfiniteDeadline, unlock);
+}
+
+void QueueScheduler::ClearTimeout(Thread & th) {
+  anarch::ScopedCritical critical;
+  ThreadObj * obj = &GetThreadObj(th);
+  uint64_t now = GetNow();
+  CPU & cpu = SeizeThreadCPU(*obj);
+  obj->deadline = 0;
+  if (obj->state != ThreadObj::StateSleeping) {
+    cpu.lock.Release();
+    return;
+  }
+  RemoveSleeping(cpu, *obj);
+  ++cpu.stats.wakeups;
+  Trace(TraceEvent::TypeWakeup, obj);
+  
+  // if the thread's CPU is busy, an idle CPU can run it sooner than waiting
+  // for a slice to end or preempting somebody, unless the thread is bound to
+  // its CPU by a reservation or the move would cost more than the wait
+  CPU * target = NULL;
+  if (cpu.current && running && !obj->bound) {
+    int waitCost = cpu.readyCount + 1 + GetMigrationCost(obj, NULL, cpu);
+    target = FindIdleCPU(cpu, obj, waitCost);
+  }
+  if (!target) {
+    Enqueue(cpu, *obj, now);
+  } else {
+    Move(cpu, *obj, *target, now);
+  }
+}
+
+void QueueScheduler::Yield() {
+  anarch::ScopedCritical critical;
+  Thread * th = Thread::GetCurrent();
+  assert(th != NULL);
+  th->GetState().SuspendAndCall(CallSwitch, (void *)this);
+}
+
+bool QueueScheduler::YieldTo(Thread & th) {
+  anarch::ScopedCritical critical;
+  Thread * current = Thread::GetCurrent();
+  assert(current != NULL);
+  if (&th == current || !ThreadUserInfo(th)) return false;
+  
+  // take the thread out of its queue, unless it may not run on this CPU
+  CPU & cpu = GetCurrentCPU();
+  ThreadObj & obj = GetThreadObj(th);
+  CPU & source = SeizeThreadCPU(obj);
+  if (obj.state != ThreadObj::StateReady ||
+      (obj.bound && obj.bound != &cpu) || !IsAllowed(obj.affinity, cpu)) {
+    source.lock.Release();
+    return false;
+  }
+  RemoveReady(source, obj);
+  obj.state = ThreadObj::StateMoving;
+  obj.cpu = &cpu;
+  source.lock.Release();
+  
+  cpu.handoff = &obj;
+  current->GetState().SuspendAndCall(CallSwitch, (void *)this);
+  return true;
+}
+
+GarbageCollector & QueueScheduler::GetGarbageCollector() { 
+  return collector;
+}
+
+WorkQueue & QueueScheduler::GetWorkQueue() {
+  return workQueue;
+}
+
+void QueueScheduler::Run() {
+  anarch::ScopedCritical critical;
+  running = true;
+  anarch::DomainList & domains = anarch::DomainList::GetGlobal();
+  for (int i = 0; i < domains.GetCount(); ++i) {
+    anarch::Domain & domain = domains[i];
+    for (int j = 0; j < domain.GetThreadCount(); ++j) {
+      anarch::Thread & thread = domain.GetThread(j);
+      if (&thread == &anarch::Thread::GetCurrent()) continue;
+      thread.RunAsync(CallSwitch, (void *)this);
+    }
+  }
+  Switch();
+}
+
+bool QueueScheduler::SetReservation(Thread & th, uint64_t runtime,
+                                    uint64_t period, uint64_t deadline) {
+  AssertNoncritical();
+  if (runtime > deadline || deadline > period) return false;
+  if (period > MaxPeriodNanos) return false;
+  if (!ThreadUserInfo(th)) return false; // not scheduled yet
+  
+  ThreadObj & obj = GetThreadObj(th);
+  uint64_t runtimeTicks = MicrosToTicks(runtime / 1000);
+  if (runtime && !runtimeTicks) return false;
+  uint32_t density = runtime ? (uint32_t)(runtime * 1000000 / deadline) : 0;
+  
+  anarch::ScopedCritical critical;
+  uint64_t now = GetNow();
+  
+  // admit the new reservation in place of the old one, if there is room
+  realtimeLock.Seize();
+  CPU * oldCPU = obj.bound;
+  if (oldCPU) oldCPU->realtimeDensity -= obj.density;
+  CPU * newCPU = NULL;
+  if (runtime) {
+    CPU & near = oldCPU ? *oldCPU : *obj.cpu;
+    newCPU = FindRealtimeCPU(near, density, obj.affinity);
+    if (!newCPU) {
+      if (oldCPU) oldCPU->realtimeDensity += obj.density;
+      realtimeLock.Release();
+      return false;
+    }
+    newCPU->realtimeDensity += density;
+  }
+  
+  CPU * cpu;
+  while (1) {
+    cpu = &SeizeThreadCPU(obj);
+    if (obj.state != ThreadObj::StateMoving) break;
+    cpu->lock.Release();
+  }
+  obj.bound = newCPU;
+  obj.density = density;
+  realtimeLock.Release();
+  
+  // take the thread out of its queue so it can be pushed to the right one
+  bool ready = (obj.state == ThreadObj::StateReady);
+  bool sleeping = (obj.state == ThreadObj::StateSleeping);
+  if (ready) {
+    RemoveReady(*cpu, obj);
+  } else if (sleeping) {
+    RemoveSleeping(*cpu, obj);
+  }
+  obj.runtime = runtimeTicks;
+  obj.period = MicrosToTicks(period / 1000);
+  obj.relativeDeadline = MicrosToTicks(deadline / 1000);
+  StartPeriod(obj, now);
+  
+  if (!ready && !sleeping) {
+    // a running thread is moved to its new CPU when it is switched out
+    cpu->lock.Release();
+  } else if (newCPU && newCPU != cpu) {
+    Move(*cpu, obj, *newCPU, now);
+  } else {
+    Enqueue(*cpu, obj, now);
+  }
+  return true;
+}
+
+bool QueueScheduler::SetRealtimeBound(uint32_t bound) {
+  AssertNoncritical();
+  if (bound > MaxRealtimeBound) return false;
+  anarch::ScopedCritical critical;
+  realtimeLock.Seize();
+  realtimeBound = bound;
+  realtimeLock.Release();
+  return true;
+}
+
+bool QueueScheduler::SetAffinity(Thread & th, uint64_t mask) {
+  AssertNoncritical();
+  if (!ThreadUserInfo(th)) return false; // not scheduled yet
+  bool allowsAny = false;
+  for (int i = 0; i < cpuCount; ++i) {
+    if (IsAllowed(mask, cpus[i])) allowsAny = true;
+  }
+  if (!allowsAny) return false;
+  
+  ThreadObj & obj = GetThreadObj(th);
+  anarch::ScopedCritical critical;
+  uint64_t now = GetNow();
+  
+  // a reserved thread may not leave the CPU that admitted it
+  realtimeLock.Seize();
+  CPU * cpu;
+  while (1) {
+    cpu = &SeizeThreadCPU(obj);
+    if (obj.state != ThreadObj::StateMoving) break;
+    cpu->lock.Release();
+  }
+  if (obj.bound && !IsAllowed(mask, *obj.bound)) {
+    cpu->lock.Release();
+    realtimeLock.Release();
+    return false;
+  }
+  obj.affinity = mask;
+  realtimeLock.Release();
+  
+  // a running thread is moved when it is switched out
+  bool ready = (obj.state == ThreadObj::StateReady);
+  bool sleeping = (obj.state == ThreadObj::StateSleeping);
+  if ((!ready && !sleeping) || IsAllowed(mask, *cpu)) {
+    cpu->lock.Release();
+    return true;
+  }
+  if (ready) {
+    RemoveReady(*cpu, obj);
+  } else {
+    RemoveSleeping(*cpu, obj);
+  }
+  Move(*cpu, obj, PlaceThread(obj, cpu), now);
+  return true;
+}
+
+bool QueueScheduler::SetQuantum(Thread & th, uint64_t quantum) {
+  AssertNoncritical();
+  if (quantum > MaxQuantumNanos) return false;
+  if (!ThreadUserInfo(th)) return false; // not scheduled yet
+  uint64_t ticks = MicrosToTicks(quantum / 1000);
+  if (quantum && !ticks) return false;
+  
+  // a running thread gets its new quantum the next time it is switched to
+  ThreadObj & obj = GetThreadObj(th);
+  anarch::ScopedCritical critical;
+  CPU & cpu = SeizeThreadCPU(obj);
+  obj.quantum = ticks;
+  cpu.lock.Release();
+  return true;
+}
+
+bool QueueScheduler::SetIdleClass(Thread & th, bool idle) {
+  AssertNoncritical();
+  if (!ThreadUserInfo(th)) return false; // not scheduled yet
+  
+  // a queued thread is moved to the right queue now; a running or sleeping
+  // thread goes there the next time it is queued
+  ThreadObj & obj = GetThreadObj(th);
+  anarch::ScopedCritical critical;
+  uint64_t now = GetNow();
+  CPU & cpu = SeizeThreadCPU(obj);
+  bool ready = (obj.state == ThreadObj::StateReady);
+  if (ready) RemoveReady(cpu, obj);
+  obj.idleClass = idle;
+  if (ready) {
+    Enqueue(cpu, obj, now);
+  } else {
+    cpu.lock.Release();
+  }
+  return true;
+}
+
+int QueueScheduler::CreateTaskGroup(uint64_t quota, uint64_t period) {
+  AssertNoncritical();
+  uint64_t quotaTicks, periodTicks;
+  if (!GetGroupLimit(quota, period, quotaTicks, periodTicks)) return -1;
+  
+  anarch::ScopedCritical critical;
+  anarch::ScopedLock scope(groupsLock);
+  for (int i = 1; i < MaxTaskGroups; ++i) {
+    TaskGroup & group = groups[i];
+    if (group.inUse) continue;
+    group.inUse = true;
+    group.taskCount = 0;
+    group.ClearStats();
+    group.SetLimit(quotaTicks, periodTicks, GetNow());
+    return i;
+  }
+  return -1;
+}
+
+bool QueueScheduler::SetTaskGroupLimit(int group, uint64_t quota,
+                                       uint64_t period) {
+  AssertNoncritical();
+  if (group <= 0 || group >= MaxTaskGroups) return false;
+  uint64_t quotaTicks, periodTicks;
+  if (!GetGroupLimit(quota, period, quotaTicks, periodTicks)) return false;
+  
+  anarch::ScopedCritical critical;
+  anarch::ScopedLock scope(groupsLock);
+  if (!groups[group].inUse) return false;
+  groups[group].SetLimit(quotaTicks, periodTicks, GetNow());
+  return true;
+}
+
+bool QueueScheduler::DestroyTaskGroup(int group) {
+  AssertNoncritical();
+  if (group <= 0 || group >= MaxTaskGroups) return false;
+  
+  anarch::ScopedCritical critical;
+  anarch::ScopedLock scope(groupsLock);
+  if (!groups[group].inUse || groups[group].taskCount) return false;
+  groups[group].inUse = false;
+  groups[group].SetLimit(0, 0, GetNow());
+  return true;
+}
+
+bool QueueScheduler::SetTaskGroup(Task & task, int group) {
+  AssertNoncritical();
+  if (group < 0 || group >= MaxTaskGroups) return false;
+  
+  // the task's threads are charged to the new group from their next switch
+  anarch::ScopedCritical critical;
+  anarch::ScopedLock scope(groupsLock);
+  if (group && !groups[group].inUse) return false;
+  int oldGroup = TaskGroupIndex(task);
+  if (oldGroup) --groups[oldGroup].taskCount;
+  if (group) ++groups[group].taskCount;
+  TaskGroupIndex(task) = group;
+  return true;
+}
+
+bool QueueScheduler::GetTaskGroupStats(int group, TaskGroupStats & stats) {
+  AssertNoncritical();
+  if (group <= 0 || group >= MaxTaskGroups) return false;
+  
+  anarch::ScopedCritical critical;
+  anarch::ScopedLock scope(groupsLock);
+  if (!groups[group].inUse) return false;
+  groups[group].GetStats(stats);
+  stats.throttledNanos = TicksToMicros(stats.throttledNanos) * 1000;
+  stats.usedNanos = TicksToMicros(stats.usedNanos) * 1000;
+  return true;
+}
+
+bool QueueScheduler::SetTracing(bool enabled) {
+  tracing = enabled;
+  return true;
+}
+
+int QueueScheduler::ReadTrace(int cpu, TraceEvent * events, int max) {
+  AssertNoncritical();
+  if (cpu < 0 || cpu >= cpuCount) return -1;
+  anarch::ScopedCritical critical;
+  anarch::ScopedLock scope(traceLock);
+  return cpus[cpu].trace.Read(events, max);
+}
+
+bool QueueScheduler::GetTraceStats(int cpu, TraceStats & stats) {
+  AssertNoncritical();
+  if (cpu < 0 || cpu >= cpuCount) return false;
+  anarch::ScopedCritical critical;
+  anarch::ScopedLock scope(cpus[cpu].lock);
+  stats = cpus[cpu].stats;
+  stats.dropped = cpus[cpu].trace.GetDropped();
+  return true;
+}
+
+void QueueScheduler::Switch() {
+  AssertCritical();
+  uint64_t now = GetNow();
+  
+  CPU & cpu = GetCurrentCPU();
+  ThreadObj * handoff = cpu.handoff;
+  uint64_t donatedEnd = cpu.sliceEnd;
+  cpu.handoff = NULL;
+  ResignCurrent(cpu, now);
+  
+  ThreadObj * obj = NULL;
+  if (handoff && Claim(cpu, *handoff)) obj = handoff;
+  while (1) {
+    if (!obj) obj = TakeRunnable(cpu, cpu, now, false);
+    if (!obj) obj = Steal(cpu, now, false);
+    
+    // idle-class threads only run once no other thread could run here
+    if (!obj) obj = TakeRunnable(cpu, cpu, now, true);
+    if (!obj) obj = Steal(cpu, now, true);
+    
+    // an idle CPU must not keep a dead task's map alive; releasing the task
+    // may queue the garbage thread here, so this comes before the check
+    if (!obj) LoadGlobalMap(cpu);
+    
+    cpu.lock.Seize();
+    if (!obj && (cpu.readyCount || cpu.idleCount ||
+                 !cpu.realtime.IsEmpty())) {
+      // a thread was queued here after we looked, and whoever queued it
+      // expects us to notice without being kicked
+      cpu.lock.Release();
+      continue;
+    }
+    break;
+  }
+  
+  // a reserved thread runs until its budget is gone, and a thread that was
+  // yielded to gets the rest of the yielding thread's slice; otherwise, only
+  // time the slice if somebody else is waiting to run on this CPU
+  cpu.current = obj;
+  cpu.runStart = now;
+  cpu.preempt = false;
+  cpu.kickPending = false;
+  cpu.idle = (!obj || obj->idleClass);
+  bool backlog = (obj && cpu.readyCount);
+  if (obj && obj->runtime) {
+    cpu.sliceEnd = now + obj->budget;
+  } else if (obj && obj == handoff && donatedEnd != InfiniteDeadline) {
+    cpu.sliceEnd = donatedEnd;
+  } else if (obj && obj->idleClass) {
+    // a thread queued here after we looked goes first, while idle-class
+    // threads take turns
+    if (backlog || !cpu.realtime.IsEmpty()) {
+      cpu.sliceEnd = now;
+    } else if (cpu.idleCount) {
+      cpu.sliceEnd = now + MicrosToTicks(IdleQuantumUs);
+    } else {
+      cpu.sliceEnd = InfiniteDeadline;
+    }
+  } else if (backlog) {
+    cpu.sliceEnd = now + cpu.queue->GetSlice(*obj);
+  } else {
+    cpu.sliceEnd = InfiniteDeadline;
+  }
+  
+  // a thread in a group may not run past what is left of the group's quota
+  TaskGroup * group = (obj ? GetTaskGroup(*obj) : NULL);
+  if (group) {
+    uint64_t left = group->GetRemaining(now);
+    if (left != InfiniteDeadline && now + left < cpu.sliceEnd) {
+      cpu.sliceEnd = now + left;
+    }
+  }
+  ProgramTimer(cpu, now);
+  if (obj) {
+    ++cpu.stats.switches;
+    Trace(TraceEvent::TypeSwitchIn, obj);
+  } else {
+    ++cpu.stats.idles;
+    Trace(TraceEvent::TypeIdle, NULL);
+  }
+  cpu.lock.Release();
+  
+  if (backlog) KickIdleCPU(cpu);
+  
+  // switch to the thread or wait for the timer or a kick
+  if (obj) {
+    Thread & nextThread = obj->thread;
+    Thread::SetCurrent(&nextThread);
+    LoadMap(cpu, nextThread.GetTask());
+    nextThread.GetState().Resume();
+  } else {
+    cpu.thread->GetTimer().WaitTimeout();
+  }
+}
+
+void QueueScheduler::ResignCurrent(CPU & cpu, uint64_t now) {
+  Thread * th = Thread::GetCurrent();
+  if (!th) return;
+  
+  Thread::SetCurrent(NULL);
+  
+  // queue it on the CPU it ran on so that it keeps using this CPU's caches
+  ThreadObj * obj = &GetThreadObj(*th);
+  assert(obj->cpu == &cpu);
+  
+  // threads whose deadlines made the timer fire go ahead of this one
+  cpu.lock.Seize();
+  WakeExpired(cpu, now);
+  uint64_t ran = now - cpu.runStart;
+  if (obj->runtime) {
+    ChargeRealtime(*obj, ran);
+  } else {
+    if (!obj->idleClass) cpu.queue->Charge(*obj, ran, obj->deadline > now);
+    TaskGroup * group = GetTaskGroup(*obj);
+    if (group) group->Charge(ran, now);
+  }
+  Trace(TraceEvent::TypeSwitchOut, obj);
+  
+  // from here until Switch() picks a thread, the CPU counts as idle; once
+  // the lock is dropped, the thread may be removed and its record freed
+  cpu.current = NULL;
+  
+  // the thread may have been given a reservation on another CPU or a new
+  // affinity while it ran
+  CPU * dest = obj->bound;
+  if (!dest && !IsAllowed(obj->affinity, cpu)) {
+    dest = &PlaceThread(*obj, &cpu);
+  }
+  if (dest && dest != &cpu) {
+    Move(cpu, *obj, *dest, now);
+  } else {
+    Push(cpu, *obj, now);
+    cpu.lock.Release();
+  }
+  
+  // if the thread's task could not be retained for its map, the map has to
+  // be unloaded before the thread (and with it the task) is released
+  if (!cpu.mapTask) LoadGlobalMap(cpu);
+  
+  // releasing the thread may throw it away, which clears the garbage thread's
+  // timeout, so no queue lock may be held here
+  th->Release();
+}
+
+void QueueScheduler::LoadMap(CPU & cpu, Task & task) {
+  AssertCritical();
+  anarch::MemoryMap & map = task.GetMemoryMap();
+  if (cpu.loadedMap == &map) return;
+  map.Set();
+  cpu.loadedMap = &map;
+  
+  // the old task is released after its map has been unloaded
+  Task * oldTask = cpu.mapTask;
+  cpu.mapTask = NULL;
+  if (task.IsUserTask() && task.Retain()) cpu.mapTask = &task;
+  if (oldTask) oldTask->Release();
+}
+
+void QueueScheduler::LoadGlobalMap(CPU & cpu) {
+  AssertCritical();
+  anarch::GlobalMap & map = anarch::GlobalMap::GetGlobal();
+  if (cpu.loadedMap != &map) {
+    map.Set();
+    cpu.loadedMap = &map;
+  }
+  Task * oldTask = cpu.mapTask;
+  cpu.mapTask = NULL;
+  if (oldTask) oldTask->Release();
+}
+
+QueueScheduler::CPU & QueueScheduler::GetCurrentCPU() {
+  AssertCritical();
+  anarch::Thread & current = anarch::Thread::GetCurrent();
+  for (int i = 0; i < cpuCount; ++i) {
+    if (cpus[i].thread == &current) return cpus[i];
+  }
+  anarch::Panic("QueueScheduler::GetCurrentCPU() - unknown CPU");
+}
+
+QueueScheduler::CPU & QueueScheduler::PlaceThread(ThreadObj & obj,
+                                                   CPU * last) {
+  // the load of a CPU is the number of threads that the new one would have
+  // to wait for; starting from [last] makes it win ties
+  int start = last ? last->index : 0;
+  CPU * result = NULL;
+  int resultCost = 0;
+  for (int i = 0; i < cpuCount; ++i) {
+    CPU & cpu = cpus[(start + i) % cpuCount];
+    if (!IsAllowed(obj.affinity, cpu)) continue;
+    int cost = cpu.readyCount + (cpu.idle ? 0 : 1);
+    cost += GetMigrationCost(&obj, last, cpu);
+    if (!result || cost < resultCost) {
+      result = &cpu;
+      resultCost = cost;
+    }
+  }
+  assert(result != NULL);
+  return *result;
+}
+
+QueueScheduler::CPU * QueueScheduler::FindIdleCPU(CPU & near,
+                                                  ThreadObj * obj,
+                                                  int maxCost) {
+  CPU * result = NULL;
+  int resultCost = maxCost;
+  for (int i = 0; i < cpuCount; ++i) {
+    CPU & cpu = cpus[(near.index + i) % cpuCount];
+    if (!cpu.idle || (obj && !IsAllowed(obj->affinity, cpu))) continue;
+    int cost = GetMigrationCost(obj, &near, cpu);
+    if (cost < resultCost) {
+      result = &cpu;
+      resultCost = cost;
+    }
+  }
+  return result;
+}
+
+QueueScheduler::CPU * QueueScheduler::FindRealtimeCPU(CPU & near,
+                                                      uint32_t density,
+                                                      uint64_t mask) {
+  AssertCritical();
+  for (int i = 0; i < cpuCount; ++i) {
+    CPU & cpu = cpus[(near.index + i) % cpuCount];
+    if (!IsAllowed(mask, cpu)) continue;
+    if (cpu.realtimeDensity + density <= realtimeBound) return &cpu;
+  }
+  return NULL;
+}
+
+int QueueScheduler::GetMigrationCost(ThreadObj * obj, CPU * from, CPU & to) {
+  // leaving the domain of the thread's caches or of its task's memory means
+  // reaching across the interconnect for its working set
+  int cost = 0;
+  if (from && from->domain != to.domain) cost += MigrationCost;
+  if (obj) {
+    anarch::Domain * memory = obj->thread.GetTask().GetMemoryDomain();
+    if (memory && memory != to.domain) cost += MigrationCost;
+  }
+  return cost;
+}
+
+TaskGroup * QueueScheduler::GetTaskGroup(ThreadObj & obj) {
+  // reserved threads answer to their reservation alone
+  if (obj.runtime) return NULL;
+  int index = TaskGroupIndex(obj.thread.GetTask());
+  return index ? &groups[index] : NULL;
+}
+
+bool QueueScheduler::GetGroupLimit(uint64_t quota, uint64_t period,
+                                   uint64_t & quotaTicks,
+                                   uint64_t & periodTicks) {
+  // a group may use more than one CPU's worth of time in a period
+  quotaTicks = periodTicks = 0;
+  if (!quota) return true;
+  if (!period || period > MaxPeriodNanos) return false;
+  if (quota > period * cpuCount) return false;
+  quotaTicks = MicrosToTicks(quota / 1000);
+  periodTicks = MicrosToTicks(period / 1000);
+  return quotaTicks && periodTicks;
+}
+
+bool QueueScheduler::IsAllowed(uint64_t mask, CPU & cpu) {
+  if (cpu.index >= 64) return mask == AnyCPU;
+  return (mask & ((uint64_t)1 << cpu.index)) != 0;
+}
+
+QueueScheduler::ThreadObj * QueueScheduler::TakeRunnable(CPU & source,
+                                                         CPU & dest,
+                                                         uint64_t now,
+                                                         bool idleClass) {
+  AssertCritical();
+  while (1) {
+    // reserved threads come first, but they may not leave their CPU
+    source.lock.Seize();
+    WakeExpired(source, now);
+    ThreadObj * obj = NULL;
+    if (idleClass) {
+      obj = (source.idleCount ? &*source.idleThreads.GetStart() : NULL);
+      if (obj && (&source == &dest || IsAllowed(obj->affinity, dest))) {
+        source.idleThreads.Remove(&obj->idleLink);
+        --source.idleCount;
+      } else {
+        obj = NULL;
+      }
+    } else if (&source == &dest) {
+      obj = source.realtime.Shift();
+      if (!obj) {
+        obj = source.queue->Shift(now);
+        if (obj) --source.readyCount;
+      }
+    } else {
+      // a thread which may not run on [dest] is left where it is
+      obj = source.queue->GetFirst();
+      if (obj && IsAllowed(obj->affinity, dest)) {
+        source.queue->Remove(*obj);
+        --source.readyCount;
+      } else {
+        obj = NULL;
+      }
+    }
+    
+    // a thread whose group has used up its quota is parked until the group's
+    // next period, and another thread is picked
+    TaskGroup * group = (obj ? GetTaskGroup(*obj) : NULL);
+    if (group && group->GetThrottleEnd() > now) {
+      Push(source, *obj, now);
+      source.lock.Release();
+      continue;
+    }
+    
+    if (obj) {
+      obj->state = ThreadObj::StateMoving;
+      obj->cpu = &dest;
+    }
+    source.lock.Release();
+    if (!obj) return NULL;
+    if (Claim(dest, *obj)) return obj;
+  }
+}
+
+bool QueueScheduler::Claim(CPU & dest, ThreadObj & obj) {
+  // Retain() seizes life locks which may be held by code that clears a
+  // timeout, so it must be called without a queue lock. Until the state
+  // leaves StateMoving, Remove() will wait for us.
+  bool retained = obj.thread.Retain();
+  dest.lock.Seize();
+  obj.state = retained ? ThreadObj::StateRunning : ThreadObj::StateDead;
+  dest.lock.Release();
+  return retained;
+}
+
+QueueScheduler::ThreadObj * QueueScheduler::Steal(CPU & cpu, uint64_t now,
+                                                  bool idleClass) {
+  // visit the other CPUs in order starting after this one so that idle CPUs
+  // do not all pick on the same victim. CPUs in this domain go first, and a
+  // CPU in another domain must have enough waiting to be worth the trip.
+  // Idle-class threads are never worth it.
+  for (int remote = 0; remote < (idleClass ? 1 : 2); ++remote) {
+    for (int i = 1; i < cpuCount; ++i) {
+      CPU & victim = cpus[(cpu.index + i) % cpuCount];
+      if ((victim.domain != cpu.domain) != (bool)remote) continue;
+      int waiting = (idleClass ? victim.idleCount : victim.readyCount);
+      if (remote) {
+        if (waiting <= MigrationCost) continue;
+      } else if (!waiting && victim.nextDeadline > now) {
+        continue;
+      }
+      ThreadObj * obj = TakeRunnable(victim, cpu, now, idleClass);
+      if (obj) return obj;
+    }
+  }
+  return NULL;
+}
+
+QueueScheduler::CPU & QueueScheduler::SeizeThreadCPU(ThreadObj & obj) {
+  AssertCritical();
+  while (1) {
+    CPU * cpu = obj.cpu;
+    cpu->lock.Seize();
+    if (obj.cpu == cpu) return *cpu;
+    // the thread was stolen while we waited for the lock
+    cpu->lock.Release();
+  }
+}
+
+void QueueScheduler::Push(CPU & cpu, ThreadObj & obj, uint64_t now) {
+  // a throttled thread sleeps until its next period even if it was woken, and
+  // so does a thread whose group is throttled
+  if (obj.runtime) UpdatePeriod(obj, now);
+  obj.wakeTime = obj.deadline;
+  if (obj.throttleEnd > obj.wakeTime) obj.wakeTime = obj.throttleEnd;
+  TaskGroup * group = GetTaskGroup(obj);
+  if (group && group->GetThrottleEnd() > obj.wakeTime) {
+    obj.wakeTime = group->GetThrottleEnd();
+  }
+  if (obj.wakeTime > now) {
+    PushSleeping(cpu, obj);
+  } else {
+    PushReady(cpu, obj, now);
+  }
+}
+
+void QueueScheduler::PushReady(CPU & cpu, ThreadObj & obj, uint64_t now) {
+  obj.state = ThreadObj::StateReady;
+  if (obj.runtime) {
+    cpu.realtime.Add(&obj.realtimeLink);
+  } else if (obj.idleClass) {
+    cpu.idleThreads.Add(&obj.idleLink);
+    ++cpu.idleCount;
+  } else {
+    cpu.queue->Push(obj, now);
+    ++cpu.readyCount;
+  }
+}
+
+void QueueScheduler::PushSleeping(CPU & cpu, ThreadObj & obj) {
+  obj.state = ThreadObj::StateSleeping;
+  cpu.timers.Add(&obj.timerLink);
+  cpu.nextDeadline = cpu.timers.GetFirst()->wakeTime;
+}
+
+void QueueScheduler::RemoveReady(CPU & cpu, ThreadObj & obj) {
+  if (obj.runtime) {
+    cpu.realtime.Remove(&obj.realtimeLink);
+  } else if (obj.idleClass) {
+    cpu.idleThreads.Remove(&obj.idleLink);
+    --cpu.idleCount;
+  } else {
+    cpu.queue->Remove(obj);
+    --cpu.readyCount;
+  }
+}
+
+void QueueScheduler::RemoveSleeping(CPU & cpu, ThreadObj & obj) {
+  cpu.timers.Remove(&obj.timerLink);
+  ThreadObj * first = cpu.timers.GetFirst();
+  cpu.nextDeadline = first ? first->wakeTime : InfiniteDeadline;
+}
+
+void QueueScheduler::WakeExpired(CPU & cpu, uint64_t now) {
+  while (cpu.nextDeadline <= now) {
+    ThreadObj * obj = cpu.timers.GetFirst();
+    RemoveSleeping(cpu, *obj);
+    Push(cpu, *obj, now);
+    if (obj->state == ThreadObj::StateReady) {
+      ++cpu.stats.wakeups;
+      Trace(TraceEvent::TypeWakeup, obj);
+    }
+  }
+}
+
+void QueueScheduler::ProgramTimer(CPU & cpu, uint64_t now) {
+  uint64_t fireTime = cpu.nextDeadline;
+  if (cpu.sliceEnd < fireTime) fireTime = cpu.sliceEnd;
+  
+  anarch::Timer & timer = cpu.thread->GetTimer();
+  if (fireTime == InfiniteDeadline) {
+    timer.ClearTimeout();
+    return;
+  }
+  
+  uint64_t micros = 0;
+  if (fireTime > now) {
+    micros = TicksToMicros(fireTime - now);
+  }
+  uint64_t timeout = timer.GetTicksPerMicro().ScaleInteger(micros);
+  if (cpu.current) {
+    timer.SetTimeout(timeout, SuspendAndSwitch, (void *)this);
+  } else {
+    timer.SetTimeout(timeout, RunSyncAndSwitch, (void *)this);
+  }
+}
+
+bool QueueScheduler::RequestSwitch(CPU & cpu, ThreadObj & pushed,
+                                   uint64_t now) {
+  // an idle CPU or a CPU without a slice timer must be told about a thread
+  // which was queued on it; a CPU with a slice timer will get to it. A CPU
+  // must also be told when its timer has to fire sooner.
+  if (pushed.state == ThreadObj::StateSleeping) {
+    if (cpu.timers.GetFirst() != &pushed) return false;
+  } else if (cpu.current) {
+    if (ShouldPreempt(cpu, pushed, now)) {
+      cpu.preempt = true;
+    } else if (cpu.sliceEnd != InfiniteDeadline) {
+      return false;
+    }
+  }
+  if (cpu.kickPending) return false;
+  cpu.kickPending = true;
+  return true;
+}
+
+bool QueueScheduler::ShouldPreempt(CPU & cpu, ThreadObj & woken,
+                                   uint64_t now) {
+  // reserved threads run ahead of all others, earliest deadline first
+  ThreadObj & current = *cpu.current;
+  if (woken.runtime) {
+    return !current.runtime ||
+      woken.absoluteDeadline < current.absoluteDeadline;
+  }
+  if (current.runtime) return false;
+  
+  // idle-class threads give way to everybody else
+  if (woken.idleClass) return false;
+  if (current.idleClass) return true;
+  return cpu.queue->ShouldPreempt(current, woken, now - cpu.runStart);
+}
+
+void QueueScheduler::ChargeRealtime(ThreadObj & obj, uint64_t ran) {
+  obj.budget -= (ran < obj.budget ? ran : obj.budget);
+}
+
+void QueueScheduler::UpdatePeriod(ThreadObj & obj, uint64_t now) {
+  // a throttled thread gets its budget back when its next period starts, and
+  // a thread that slept through the rest of its period starts a new one
+  if (obj.throttleEnd && obj.throttleEnd <= now) {
+    StartPeriod(obj, obj.throttleEnd);
+  }
+  if (now >= obj.periodStart + obj.period) {
+    StartPeriod(obj, now);
+  }
+  if (!obj.budget) {
+    obj.throttleEnd = obj.periodStart + obj.period;
+  }
+}
+
+void QueueScheduler::StartPeriod(ThreadObj & obj, uint64_t start) {
+  obj.periodStart = start;
+  obj.absoluteDeadline = start + obj.relativeDeadline;
+  obj.budget = obj.runtime;
+  obj.throttleEnd = 0;
+}
+
+void QueueScheduler::WriteTrace(TraceEvent::Type type, ThreadObj * obj) {
+  AssertCritical();
+  CPU & cpu = GetCurrentCPU();
+  TraceEvent event;
+  event.time = GetNow();
+  event.task = 0;
+  event.thread = 0;
+  if (obj) {
+    event.task = (uint32_t)obj->thread.GetTask().GetIdentifier();
+    event.thread = (uint32_t)obj->thread.GetIdentifier();
+  }
+  event.type = (uint32_t)type;
+  event.depth = (uint32_t)(int)cpu.readyCount;
+  cpu.trace.Write(event);
+}
+
+void QueueScheduler::Enqueue(CPU & cpu, ThreadObj & obj, uint64_t now) {
+  AssertCritical();
+  Push(cpu, obj, now);
+  bool kick = running && RequestSwitch(cpu, obj, now);
+  cpu.lock.Release();
+  if (kick) SendKick(cpu);
+}
+
+void QueueScheduler::Move(CPU & cpu, ThreadObj & obj, CPU & dest,
+                          uint64_t now) {
+  AssertCritical();
+  obj.state = ThreadObj::StateMoving;
+  obj.cpu = &dest;
+  cpu.lock.Release();
+  
+  dest.lock.Seize();
+  Enqueue(dest, obj, now);
+}
+
+void QueueScheduler::SendKick(CPU & cpu) {
+  AssertCritical();
+  if (cpu.thread != &anarch::Thread::GetCurrent()) {
+    cpu.thread->RunAsync(HandleKick, (void *)this);
+  } else if (Thread::GetCurrent()) {
+    // we cannot switch away from whatever code is waking up a thread, but the
+    // timer can fire as soon as it leaves its critical section
+    Reprogram(cpu);
+  }
+  // otherwise, we are inside Switch() on this CPU and it will see the queue
+}
+
+void QueueScheduler::KickIdleCPU(CPU & busy) {
+  AssertCritical();
+  // an idle CPU in another domain would not steal unless this one has more
+  // than MigrationCost threads waiting
+  CPU * idle = FindIdleCPU(busy, NULL, busy.readyCount);
+  if (!idle || idle->kickPending) return;
+  idle->kickPending = true;
+  SendKick(*idle);
+}
+
+void QueueScheduler::Reprogram(CPU & cpu) {
+  AssertCritical();
+  uint64_t now = GetNow();
+  anarch::ScopedLock scope(cpu.lock);
+  cpu.kickPending = false;
+  if (!cpu.current) return;
+  
+  // a CPU running an idle-class thread is kicked when there is work for it
+  // somewhere, which it has to switch to find
+  if (cpu.preempt || cpu.current->idleClass) {
+    cpu.preempt = false;
+    cpu.sliceEnd = now;
+  } else if (cpu.sliceEnd == InfiniteDeadline && cpu.readyCount) {
+    cpu.sliceEnd = cpu.runStart + cpu.queue->GetSlice(*cpu.current);
+  }
+  ProgramTimer(cpu, now);
+}
+
+uint64_t QueueScheduler::AdaptSlice(uint64_t quantum, int waiting) {
+  if (waiting <= ShrinkAfter) return quantum;
+  uint64_t slice = quantum * ShrinkAfter / waiting;
+  uint64_t minSlice = MicrosToTicks(MinSliceUs);
+  if (slice >= minSlice) return slice;
+  return quantum < minSlice ? quantum : minSlice;
+}
+
+uint64_t QueueScheduler::MicrosToTicks(uint64_t micros) {
+  anarch::Clock & clock = anarch::ClockModule::GetGlobal().GetClock();
+  return clock.GetMicrosPerTick().Flip().ScaleInteger(micros);
+}
+
+uint64_t QueueScheduler::TicksToMicros(uint64_t ticks) {
+  anarch::Clock & clock = anarch::ClockModule::GetGlobal().GetClock();
+  return clock.GetMicrosPerTick().ScaleInteger(ticks);
+}
+
+uint64_t QueueScheduler::GetNow() {
+  return anarch::ClockModule::GetGlobal().GetClock().GetTicks();
+}
+
+bool QueueScheduler::IsEarlier(const ThreadObj & a, const ThreadObj & b) {
+  return a.wakeTime < b.wakeTime;
+}
+
+bool QueueScheduler::IsMoreUrgent(const ThreadObj & a, const ThreadObj & b) {
+  return a.absoluteDeadline < b.absoluteDeadline;
+}
+
+void QueueScheduler::CallSwitch(void * scheduler) {
+  ((QueueScheduler *)scheduler)->Switch();
+}
+
+void QueueScheduler::SuspendAndSwitch(void * scheduler) {
+  Thread * thread = Thread::GetCurrent();
+  assert(thread != NULL);
+  thread->GetState().SuspendAndCall(CallSwitch, scheduler);
+}
+
+void QueueScheduler::RunSyncAndSwitch(void * scheduler) {
+  anarch::Thread::RunSync(CallSwitch, scheduler);
+}
+
+void QueueScheduler::HandleKick(void * scheduler) {
+  // a running thread is preempted or given a slice through the timer; an
+  // idle CPU looks for something to run right away
+  if (Thread::GetCurrent()) {
+    QueueScheduler & sched = *(QueueScheduler *)scheduler;
+    sched.Reprogram(sched.GetCurrentCPU());
+  } else {
+    RunSyncAndSwitch(scheduler);
+  }
+}
+
+}
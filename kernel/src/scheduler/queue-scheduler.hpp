@@ -0,0 +1,416 @@
+#ifndef __ALUX_QUEUE_SCHEDULER_HPP__
+#define __ALUX_QUEUE_SCHEDULER_HPP__
+
+#include "scheduler.hpp"
+#include "../tasks/kernel-task.hpp"
+#include "../containers/pairing-heap.hpp"
+#include <anarch/api/thread>
+#include <anarch/api/domain>
+#include <ansa/atomic>
+#include <ansa/atomic-ptr>
+#include <ansa/linked-list>
+
+namespace Alux {
+
+/**
+ * The machinery shared by Alux's schedulers. Every CPU has its own run queue
+ * so that context switches on different CPUs do not contend for one lock. A
+ * thread is queued back on the CPU that last ran it; a CPU with nothing of its
+ * own to run steals threads from the other CPUs' queues.
+ *
+ * Each CPU keeps threads with a pending timeout in a heap ordered by deadline,
+ * so finding the next thread to run does not depend on how many threads are
+ * asleep. The order of runnable threads is up to a subclass, which provides a
+ * [RunQueue] for every CPU and a [ThreadObj] for every thread. A subclass
+ * must call [Initialize] from its constructor.
+ *
+ * The scheduler is tickless: a CPU's timer only fires at the end of a time
+ * slice when another thread is waiting for the CPU, or at the earliest
+ * deadline in the CPU's heap. A CPU with neither is not interrupted until
+ * another CPU queues work for it and kicks it.
+ *
+ * Address spaces are switched lazily. A CPU keeps the last user task's
+ * memory map loaded, and retains the task so that the map cannot be freed,
+ * until it runs a thread that uses a different map or goes idle.
+ *
+ * Kicks are inter-processor interrupts sent with RunAsync(). A thread that is
+ * woken while its CPU is busy is moved to an idle CPU if there is one.
+ * Otherwise, the run queue decides whether it preempts the running thread.
+ *
+ * Threads with a reservation from [SetReservation] form a real-time class
+ * that always runs ahead of the run queue. Each such thread is bound to one
+ * CPU, which runs them in earliest-deadline-first order. A reservation is
+ * only admitted if it keeps the CPU's real-time density within the bound
+ * that root sets with [SetRealtimeBound], and a thread that uses up its
+ * budget is throttled until its next period starts.
+ *
+ * A thread only runs on the CPUs in its affinity mask. Within the mask, the
+ * scheduler keeps threads in the [anarch::Domain] of the CPU they last ran on
+ * and of their task's memory: a CPU in another domain counts as
+ * [MigrationCost] more threads of load, and an idle CPU only steals from
+ * another domain when the victim has more than that many threads waiting.
+ *
+ * Tasks may be put in a [TaskGroup] whose threads share a CPU bandwidth
+ * quota. A thread of a group that has used up its quota is parked among the
+ * sleeping threads, whether it is picked to run or woken, until the group's
+ * next period starts. Reserved threads are exempt from their group's quota.
+ *
+ * A thread's quantum may be set with [SetQuantum]; otherwise the run queue
+ * picks one. A CPU with a single runnable thread never interrupts it.
+ *
+ * Threads put in the idle class with [SetIdleClass] never enter the run
+ * queue. Each CPU keeps them in a FIFO list which is only looked at when
+ * neither the CPU's own queues nor any CPU it could steal from has another
+ * thread to run. A CPU that runs an idle-class thread counts as idle, and any
+ * other thread that becomes runnable there preempts it.
+ *
+ * Every CPU counts its switches and wakeups in [TraceStats]. When tracing is
+ * turned on with [SetTracing], it also records each [TraceEvent] in its own
+ * [TraceBuffer], which a user task drains with [ReadTrace].
+ */
+class QueueScheduler : public Scheduler {
+public:
+  static const uint32_t DefaultRealtimeBound = 900000;
+  static const uint32_t MaxRealtimeBound = 1000000;
+  static const uint64_t AnyCPU = 0xffffffffffffffffUL;
+  static const int MigrationCost = 2;
+  static const uint64_t MinQuantumUs = 1000;
+  static const uint64_t MaxQuantumUs = 1000000;
+  static const int MaxTaskGroups = 64;
+  static const size_t MaxThreadObjSize = 0x200;
+  
+  QueueScheduler(); // @noncritical
+  virtual ~QueueScheduler(); // @noncritical
+  
+  virtual void Add(Thread &);
+  virtual void Remove(Thread &);
+  
+  virtual void SetTimeout(uint64_t deadline);
+  virtual void SetTimeout(uint64_t deadline, ansa::Lock & unlock);
+  virtual void SetInfiniteTimeout();
+  virtual void SetInfiniteTimeout(ansa::Lock & unlock);
+  
+  virtual void ClearTimeout(Thread &);
+  virtual void Yield();
+  virtual bool YieldTo(Thread &);
+  
+  virtual GarbageCollector & GetGarbageCollector();
+  virtual WorkQueue & GetWorkQueue();
+  virtual void Run();
+  
+  virtual bool SetReservation(Thread &, uint64_t runtime, uint64_t period,
+                              uint64_t deadline);
+  virtual bool SetRealtimeBound(uint32_t bound);
+  virtual bool SetAffinity(Thread &, uint64_t mask);
+  virtual bool SetQuantum(Thread &, uint64_t quantum);
+  virtual bool SetIdleClass(Thread &, bool idle);
+  
+  virtual int CreateTaskGroup(uint64_t quota, uint64_t period);
+  virtual bool SetTaskGroupLimit(int group, uint64_t quota, uint64_t period);
+  virtual bool DestroyTaskGroup(int group);
+  virtual bool SetTaskGroup(Task &, int group);
+  virtual bool GetTaskGroupStats(int group, TaskGroupStats &);
+  
+  virtual bool SetTracing(bool enabled);
+  virtual int ReadTrace(int cpu, TraceEvent * events, int max);
+  virtual bool GetTraceStats(int cpu, TraceStats & stats);
+  
+protected:
+  static const uint64_t InfiniteDeadline = 0xffffffffffffffffUL;
+  static const uint64_t MaxPeriodNanos = 10000000000UL;
+  static const uint64_t MaxQuantumNanos = 1000000000UL;
+  static const int ShrinkAfter = 4;
+  static const uint64_t MinSliceUs = 1000;
+  static const uint64_t IdleQuantumUs = 10000;
+  
+  struct CPU;
+  struct ThreadObj;
+  
+  static bool IsEarlier(const ThreadObj &, const ThreadObj &);
+  static bool IsMoreUrgent(const ThreadObj &, const ThreadObj &);
+  
+  typedef PairingHeap<ThreadObj, IsEarlier> TimerHeap;
+  typedef PairingHeap<ThreadObj, IsMoreUrgent> RealtimeHeap;
+  
+  /**
+   * The scheduler's record of a thread. A subclass derives from this to store
+   * whatever its run queue needs.
+   */
+  struct ThreadObj {
+    enum QueueState {
+      StateReady, // in its CPU's [queue], [realtime] or [idleThreads]
+      StateSleeping, // in its CPU's [timers] heap, maybe because throttled
+      StateMoving, // between two queues, or being retained by a CPU
+      StateRunning,
+      StateDead // could not be retained; waiting for [Remove]
+    };
+    
+    inline ThreadObj(Thread & t)
+      : timerLink(*this), realtimeLink(*this), idleLink(*this), thread(t) {}
+    virtual ~ThreadObj() {}
+    
+    // every subclass must fit in [MaxThreadObjSize] bytes
+    static void * operator new(size_t); // @noncritical
+    static void operator delete(void *, size_t); // @noncritical
+    
+    TimerHeap::Link timerLink;
+    RealtimeHeap::Link realtimeLink;
+    ansa::LinkedList<ThreadObj>::Link idleLink;
+    Thread & thread;
+    
+    // The CPU whose queue this thread belongs to. While the thread is running
+    // it is not in any queue, and this is the CPU that is running it.
+    ansa::AtomicPtr<CPU> cpu;
+    
+    // [deadline] and [state] are protected by the lock of [cpu]. So is any
+    // field that a subclass adds. [wakeTime] orders the [timers] heap.
+    uint64_t deadline = 0;
+    uint64_t wakeTime = 0;
+    QueueState state = StateReady;
+    
+    // The reservation, in clock ticks. [runtime] is 0 for a thread that is
+    // scheduled by the run queue. These fields are protected by the lock of
+    // [cpu]; [bound] and [density] are also protected by [realtimeLock].
+    uint64_t runtime = 0;
+    uint64_t period = 0;
+    uint64_t relativeDeadline = 0;
+    CPU * bound = NULL;
+    uint32_t density = 0;
+    
+    // The current period of a reserved thread. [throttleEnd] is non-zero
+    // while the thread has used up its [budget].
+    uint64_t periodStart = 0;
+    uint64_t absoluteDeadline = 0;
+    uint64_t budget = 0;
+    uint64_t throttleEnd = 0;
+    
+    // The thread's own quantum in clock ticks, or 0 if it uses the run
+    // queue's default. Protected by the lock of [cpu].
+    uint64_t quantum = 0;
+    
+    // Set for a thread in the idle class, which is queued in [idleThreads]
+    // rather than the run queue. Protected by the lock of [cpu].
+    bool idleClass = false;
+    
+    // Bit `n` allows the `n`th CPU; CPUs past the 64th are only allowed by
+    // AnyCPU. Protected by the lock of [cpu] and by [realtimeLock].
+    uint64_t affinity = AnyCPU;
+  };
+  
+  /**
+   * The runnable threads of one CPU. Every method is @critical and is called
+   * with the CPU's lock held. Times are in clock ticks.
+   */
+  class RunQueue {
+  public:
+    virtual ~RunQueue() {}
+    
+    /**
+     * Add a thread which has become runnable.
+     */
+    virtual void Push(ThreadObj &, uint64_t now) = 0;
+    
+    /**
+     * Remove and return the thread which should run next, or NULL if the
+     * queue is empty.
+     */
+    virtual ThreadObj * Shift(uint64_t now) = 0;
+    
+    /**
+     * Return the thread which [Shift] would remove next without removing it,
+     * or NULL if the queue is empty.
+     */
+    virtual ThreadObj * GetFirst() = 0;
+    
+    /**
+     * Remove a thread which is in this queue.
+     */
+    virtual void Remove(ThreadObj &) = 0;
+    
+    /**
+     * Account for the [ran] ticks that a thread just spent on this CPU. If
+     * [blocked] is `true`, the thread is going to sleep rather than being
+     * pushed back on the queue.
+     */
+    virtual void Charge(ThreadObj &, uint64_t ran, bool blocked) = 0;
+    
+    /**
+     * Return the number of ticks that [current] may run, counting from when
+     * it was switched to, before it yields to another thread in the queue.
+     */
+    virtual uint64_t GetSlice(ThreadObj & current) = 0;
+    
+    /**
+     * Return `true` if [woken], which was just pushed, should take the CPU
+     * from [current] right away. [ran] is how long [current] has been running.
+     */
+    virtual bool ShouldPreempt(ThreadObj & current, ThreadObj & woken,
+                               uint64_t ran) = 0;
+  };
+  
+  struct CPU {
+    anarch::Thread * thread = NULL;
+    anarch::Domain * domain = NULL;
+    int index = 0;
+    
+    // [lock] protects [queue], [realtime], [idleThreads] and [timers]. The
+    // counters may be read without it when looking for a CPU to steal from
+    // or to place a new thread on. [readyCount] only counts threads in
+    // [queue], since threads in [realtime] cannot be stolen and those in
+    // [idleThreads] are counted by [idleCount].
+    anarch::CriticalLock lock;
+    RunQueue * queue = NULL;
+    RealtimeHeap realtime;
+    ansa::LinkedList<ThreadObj> idleThreads;
+    TimerHeap timers;
+    ansa::Atomic<int> readyCount;
+    ansa::Atomic<int> idleCount;
+    ansa::Atomic<uint64_t> nextDeadline;
+    
+    // protected by [realtimeLock]
+    uint32_t realtimeDensity = 0;
+    
+    // The following fields are protected by [lock]. The slice only ends if
+    // another thread is waiting; otherwise [sliceEnd] is InfiniteDeadline.
+    ThreadObj * current = NULL;
+    uint64_t runStart = 0;
+    uint64_t sliceEnd = InfiniteDeadline;
+    bool preempt = false;
+    
+    // [stats] is protected by [lock]; only this CPU writes to [trace]
+    TraceStats stats;
+    TraceBuffer trace;
+    
+    // set by YieldTo() right before it switches; only this CPU touches it
+    ThreadObj * handoff = NULL;
+    
+    // The memory map that is loaded, and the retained task that owns it if
+    // it is a user map. Only this CPU touches these.
+    anarch::MemoryMap * loadedMap = NULL;
+    Task * mapTask = NULL;
+    
+    // [kickPending] is set when a kick has been sent but not yet handled, so
+    // a burst of wakeups sends the CPU only one interrupt. [idle] is also set
+    // while the CPU runs an idle-class thread.
+    ansa::Atomic<bool> kickPending;
+    ansa::Atomic<bool> idle;
+  };
+  
+  int cpuCount;
+  CPU * cpus;
+  
+  /**
+   * Create the run queues and the garbage thread. Call this once from the
+   * subclass's constructor.
+   * @noncritical
+   */
+  void Initialize();
+  
+  /**
+   * Allocate the record for a thread that is being added.
+   * @noncritical
+   */
+  virtual ThreadObj & NewThreadObj(Thread &) = 0;
+  
+  /**
+   * Allocate the run queue for a CPU.
+   * @noncritical
+   */
+  virtual RunQueue & NewRunQueue() = 0;
+  
+  static inline ThreadObj & GetThreadObj(Thread & th) {
+    return *(ThreadObj *)ThreadUserInfo(th);
+  }
+  
+  CPU & SeizeThreadCPU(ThreadObj &); // @critical
+  
+  /**
+   * Return the slice for a thread with [quantum] ticks while [waiting]
+   * threads wait for its CPU. Up to [ShrinkAfter] waiting threads each get a
+   * full quantum; beyond that, slices shrink so that a round takes no longer
+   * than [ShrinkAfter] quanta, but no further than [MinSliceUs].
+   * @ambicritical
+   */
+  static uint64_t AdaptSlice(uint64_t quantum, int waiting);
+  
+  static uint64_t MicrosToTicks(uint64_t micros); // @ambicritical
+  static uint64_t TicksToMicros(uint64_t ticks); // @ambicritical
+  static uint64_t GetNow(); // @ambicritical
+  
+private:
+  ansa::Atomic<bool> running;
+  
+  anarch::CriticalLock realtimeLock;
+  uint32_t realtimeBound = DefaultRealtimeBound;
+  
+  // [traceLock] serializes readers of the CPUs' trace buffers
+  ansa::Atomic<bool> tracing;
+  anarch::CriticalLock traceLock;
+  
+  // [groupsLock] protects which groups are in use and their task counts;
+  // index 0 is never used
+  anarch::CriticalLock groupsLock;
+  TaskGroup * groups;
+  
+  WorkQueue workQueue;
+  GarbageCollector collector;
+  KernelTask * workerTask;
+  
+  void Switch(); // @critical
+  void ResignCurrent(CPU &, uint64_t now); // @critical
+  void LoadMap(CPU &, Task &); // @critical
+  void LoadGlobalMap(CPU &); // @critical
+  
+  CPU & GetCurrentCPU(); // @critical
+  CPU & PlaceThread(ThreadObj &, CPU * last); // @ambicritical
+  CPU * FindIdleCPU(CPU & near, ThreadObj *, int maxCost); // @ambicritical
+  CPU * FindRealtimeCPU(CPU & near, uint32_t density, uint64_t mask);
+  int GetMigrationCost(ThreadObj *, CPU * from, CPU & to); // @ambicritical
+  static bool IsAllowed(uint64_t mask, CPU &); // @ambicritical
+  ThreadObj * TakeRunnable(CPU & source, CPU & dest, uint64_t now,
+                           bool idleClass);
+  bool Claim(CPU & dest, ThreadObj &); // @critical
+  ThreadObj * Steal(CPU &, uint64_t now, bool idleClass); // @critical
+  
+  // these are @critical, unsynchronized; the CPU's lock must be held
+  void Push(CPU &, ThreadObj &, uint64_t now);
+  void PushReady(CPU &, ThreadObj &, uint64_t now);
+  void PushSleeping(CPU &, ThreadObj &);
+  void RemoveReady(CPU &, ThreadObj &);
+  void RemoveSleeping(CPU &, ThreadObj &);
+  void WakeExpired(CPU &, uint64_t now);
+  void ProgramTimer(CPU &, uint64_t now);
+  bool RequestSwitch(CPU &, ThreadObj & pushed, uint64_t now);
+  bool ShouldPreempt(CPU &, ThreadObj & woken, uint64_t now);
+  
+  TaskGroup * GetTaskGroup(ThreadObj &); // @ambicritical
+  bool GetGroupLimit(uint64_t quota, uint64_t period, uint64_t & quotaTicks,
+                     uint64_t & periodTicks); // @ambicritical
+  
+  // these are @critical and only touch the thread
+  void ChargeRealtime(ThreadObj &, uint64_t ran);
+  void UpdatePeriod(ThreadObj &, uint64_t now);
+  void StartPeriod(ThreadObj &, uint64_t start);
+  
+  // these are @critical and record an event in the current CPU's trace
+  // buffer; Trace() costs one load while tracing is off
+  inline void Trace(TraceEvent::Type type, ThreadObj * obj) {
+    if (tracing) WriteTrace(type, obj);
+  }
+  void WriteTrace(TraceEvent::Type, ThreadObj *);
+  
+  void Enqueue(CPU & locked, ThreadObj &, uint64_t now); // @critical
+  void Move(CPU & locked, ThreadObj &, CPU & dest, uint64_t now); // @critical
+  void SendKick(CPU &); // @critical
+  void KickIdleCPU(CPU & busy); // @critical
+  void Reprogram(CPU &); // @critical, must run on the CPU
+  
+  static void CallSwitch(void * scheduler);
+  static void SuspendAndSwitch(void * scheduler);
+  static void RunSyncAndSwitch(void * scheduler);
+  static void HandleKick(void * scheduler);
+};
+
+}
+
+#endif
@@ -1,65 +1,58 @@
 #ifndef __ALUX_RR_SCHEDULER_HPP__
 #define __ALUX_RR_SCHEDULER_HPP__
 
-#include "scheduler.hpp"
-#include "../tasks/kernel-task.hpp"
-#include <ansa/atomic>
+#include "queue-scheduler.hpp"
+#include <ansa/linked-list>
 
 namespace Alux {
 
 /**
- * This is a single-queue round-robin scheduler with timer support. This is not
- * particularly optimized for SMP systems, although it will work on them.
+ * This is a round-robin scheduler with timer support. Each CPU runs the
+ * threads in its queue in FIFO order. Each thread gets a slice of its own
+ * quantum or the scheduler's, which is chosen at boot and defaults to
+ * [DefaultQuantumUs]; slices shrink when many threads are waiting.
+ *
+ * A woken thread which is next in line preempts the running thread once that
+ * thread has run for [WakeupGranularityUs].
  */
-class RRScheduler : public Scheduler {
+class RRScheduler : public QueueScheduler {
 public:
-  static const uint64_t JiffyUs = 50000;
+  static const uint64_t DefaultQuantumUs = 50000;
+  static const uint64_t WakeupGranularityUs = 1000;
   
-  RRScheduler(); // @noncritical
-  
-  virtual void Add(Thread &);
-  virtual void Remove(Thread &);
-  
-  virtual void SetTimeout(uint64_t deadline);
-  virtual void SetTimeout(uint64_t deadline, ansa::Lock & unlock);
-  virtual void SetInfiniteTimeout();
-  virtual void SetInfiniteTimeout(ansa::Lock & unlock);
-  
-  virtual void ClearTimeout(Thread &);
-  virtual void Yield();
-  
-  virtual GarbageCollector & GetGarbageCollector();
-  virtual void Run();
+  RRScheduler(uint64_t quantumUs = DefaultQuantumUs); // @noncritical
   
 protected:
-  virtual void SetGarbageTimeout(ansa::Lock & unlock);
-  virtual void ClearGarbageTimeout();
+  virtual ThreadObj & NewThreadObj(Thread &);
+  virtual RunQueue & NewRunQueue();
   
 private:
-  struct ThreadObj {
-    inline ThreadObj(Thread & t) : link(*this), thread(t) {}
+  struct RRThreadObj : public ThreadObj {
+    inline RRThreadObj(Thread & t) : ThreadObj(t), link(*this) {}
     
-    ansa::LinkedList<ThreadObj>::Link link;
-    Thread & thread;
-    ansa::Atomic<uint64_t> deadline;
-    bool running = false;
+    ansa::LinkedList<RRThreadObj>::Link link;
   };
   
-  anarch::CriticalLock lock;
-  ansa::LinkedList<ThreadObj> threads;
-  
-  GarbageCollector collector;
-  KernelTask * collectorTask;
-  Thread * collectorThread;
-  
-  void Switch(); // @critical
-  void ResignCurrent(); // @critical, unsynchronized
-  
-  static void CallSwitch(void * scheduler);
-  static void SuspendAndSwitch(void * scheduler);
-  static void RunSyncAndSwitch(void * scheduler);
+  class RRRunQueue : public RunQueue {
+  public:
+    inline RRRunQueue(uint64_t q) : quantumUs(q) {}
+    
+    virtual void Push(ThreadObj &, uint64_t now);
+    virtual ThreadObj * Shift(uint64_t now);
+    virtual ThreadObj * GetFirst();
+    virtual void Remove(ThreadObj &);
+    virtual void Charge(ThreadObj &, uint64_t ran, bool blocked);
+    virtual uint64_t GetSlice(ThreadObj & current);
+    virtual bool ShouldPreempt(ThreadObj & current, ThreadObj & woken,
+                               uint64_t ran);
+  
+  private:
+    ansa::LinkedList<RRThreadObj> threads;
+    int count = 0;
+    uint64_t quantumUs;
+  };
   
-  static void RunGarbageThread(void * garbage);
+  uint64_t quantumUs;
 };
 
 }
@@ -2,6 +2,9 @@
 #define __ALUX_SCHEDULER__
 
 #include "garbage-collector.hpp"
+#include "work-queue.hpp"
+#include "trace-buffer.hpp"
+#include "task-group.hpp"
 #include "../containers/task-list.hpp"
 #include <anarch/stdint>
 #include <ansa/lock>
@@ -73,6 +76,15 @@ public:
    */
   virtual void Yield() = 0;
   
+  /**
+   * Give the rest of the current thread's time slice to another thread by
+   * switching straight to it on this CPU. This only works if the other thread
+   * is waiting in a run queue; otherwise, `false` is returned right away and
+   * the current thread keeps running. The caller must have [th] retained.
+   * @ambicritical
+   */
+  virtual bool YieldTo(Thread & th) = 0;
+  
   /**
    * Call this ONCE to start the scheduler. The scheduler is responsible for
    * waking up other CPUs and performing context switches from here on out.
@@ -86,6 +98,168 @@ public:
    */
   virtual GarbageCollector & GetGarbageCollector() = 0;
   
+  /**
+   * Get the queue which runs this scheduler's deferred work.
+   * @ambicritical
+   */
+  virtual WorkQueue & GetWorkQueue() = 0;
+  
+  /**
+   * Set the base priority of a thread, where 0 is the most urgent. Returns
+   * `false` if the priority is out of range or this scheduler does not have
+   * priorities.
+   * @noncritical
+   */
+  virtual bool SetPriority(Thread &, int) {
+    return false;
+  }
+  
+  /**
+   * Return the number of priorities that [SetPriority] accepts, or 0 if this
+   * scheduler does not have priorities.
+   * @ambicritical
+   */
+  virtual int GetPriorityCount() {
+    return 0;
+  }
+  
+  /**
+   * Return the priority that threads start out with. Only root may give a
+   * thread a more urgent priority than this.
+   * @ambicritical
+   */
+  virtual int GetDefaultPriority() {
+    return 0;
+  }
+  
+  /**
+   * Guarantee a thread [runtime] nanoseconds of CPU time within [deadline]
+   * nanoseconds of the start of every [period]. A [runtime] of 0 removes the
+   * thread's reservation. Returns `false` if the reservation is malformed or
+   * cannot be guaranteed, or if this scheduler does not support reservations.
+   * @noncritical
+   */
+  virtual bool SetReservation(Thread &, uint64_t, uint64_t, uint64_t) {
+    return false;
+  }
+  
+  /**
+   * Set the share of each CPU, in millionths, that reservations may use
+   * altogether. This only affects reservations that are made afterwards.
+   * Returns `false` if [bound] is above 1000000 or this scheduler does not
+   * support reservations.
+   * @noncritical
+   */
+  virtual bool SetRealtimeBound(uint32_t) {
+    return false;
+  }
+  
+  /**
+   * Restrict a thread to the CPUs whose bits are set in [mask], where bit `n`
+   * stands for the `n`th CPU of the [DomainList]. Returns `false` if the mask
+   * leaves the thread no CPU to run on or this scheduler does not support
+   * affinity.
+   * @noncritical
+   */
+  virtual bool SetAffinity(Thread &, uint64_t) {
+    return false;
+  }
+  
+  /**
+   * Set the number of nanoseconds that a thread may run before a thread
+   * waiting for its CPU gets a turn. A [quantum] of 0 restores the
+   * scheduler's default. Returns `false` if the quantum is out of range or
+   * this scheduler does not support per-thread quanta.
+   * @noncritical
+   */
+  virtual bool SetQuantum(Thread &, uint64_t) {
+    return false;
+  }
+  
+  /**
+   * Put a thread in the idle class, or take it back out. A thread in the idle
+   * class only runs when there is nothing else for its CPUs to run. Returns
+   * `false` if this scheduler does not have an idle class.
+   * @noncritical
+   */
+  virtual bool SetIdleClass(Thread &, bool) {
+    return false;
+  }
+  
+  /**
+   * Create a task group whose tasks together may use [quota] nanoseconds of
+   * CPU time in every [period] nanoseconds. A [quota] of 0 sets no limit.
+   * Returns the group's index, which is never 0, or -1 if the limit is
+   * malformed, there are too many groups, or this scheduler has no groups.
+   * @noncritical
+   */
+  virtual int CreateTaskGroup(uint64_t, uint64_t) {
+    return -1;
+  }
+  
+  /**
+   * Change the limit of a group, as with [CreateTaskGroup]. Returns `false`
+   * if the group does not exist or the limit is malformed.
+   * @noncritical
+   */
+  virtual bool SetTaskGroupLimit(int, uint64_t, uint64_t) {
+    return false;
+  }
+  
+  /**
+   * Destroy a group that no task belongs to any longer. Returns `false` if
+   * the group does not exist or still has tasks.
+   * @noncritical
+   */
+  virtual bool DestroyTaskGroup(int) {
+    return false;
+  }
+  
+  /**
+   * Move a task into a group, or out of its group if [group] is 0. Returns
+   * `false` if the group does not exist.
+   * @noncritical
+   */
+  virtual bool SetTaskGroup(Task &, int) {
+    return false;
+  }
+  
+  /**
+   * Read the counters of a group. Returns `false` if it does not exist.
+   * @noncritical
+   */
+  virtual bool GetTaskGroupStats(int, TaskGroupStats &) {
+    return false;
+  }
+  
+  /**
+   * Start or stop recording scheduling events. Returns `false` if this
+   * scheduler cannot trace.
+   * @ambicritical
+   */
+  virtual bool SetTracing(bool) {
+    return false;
+  }
+  
+  /**
+   * Move up to [max] of the oldest events recorded by the CPU at index [cpu]
+   * into [events]. Returns the number of events moved, or -1 if there is no
+   * such CPU or this scheduler cannot trace.
+   * @noncritical
+   */
+  virtual int ReadTrace(int, TraceEvent *, int) {
+    return -1;
+  }
+  
+  /**
+   * Copy the counters of the CPU at index [cpu] into [stats]. Returns `false`
+   * if there is no such CPU or this scheduler keeps no counters.
+   * @noncritical
+   */
+  virtual bool GetTraceStats(int, TraceStats &) {
+    return false;
+  }
+  
   /**
    * Get the task list. While you can technically get the task list from a
    * critical section, you cannot manipulate or search it while in a critical
@@ -97,14 +271,6 @@ public:
   }
   
 protected:
-  friend class GarbageCollector;
-  
-  /**
-   * Clear the timeout on the garbage thread.
-   * @ambicritical
-   */
-  virtual void ClearGarbageTimeout() = 0;
-  
   /**
    * Friend functions are not inherited (thanks a lot, C++ standards 
    * committee.) Instead, I have to make a method in this base class so
@@ -114,6 +280,21 @@ protected:
     return th.schedulerUserInfo;
   }
   
+  /**
+   * Like [ThreadUserInfo], but for a task's protected `schedulerThreadCount`
+   * field.
+   */
+  inline static ansa::Atomic<int> & TaskThreadCount(Task & t) {
+    return t.schedulerThreadCount;
+  }
+  
+  /**
+   * Like [ThreadUserInfo], but for a task's protected `schedulerGroup` field.
+   */
+  inline static ansa::Atomic<int> & TaskGroupIndex(Task & t) {
+    return t.schedulerGroup;
+  }
+  
 private:
   TaskList taskList;
 };
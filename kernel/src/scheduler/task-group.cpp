@@ -0,0 +1,65 @@
+#include "task-group.hpp"
+#include <anarch/critical>
+
+namespace Alux {
+
+void TaskGroup::SetLimit(uint64_t aQuota, uint64_t aPeriod, uint64_t now) {
+  AssertCritical();
+  anarch::ScopedLock scope(lock);
+  if (throttleEnd) {
+    stats.throttledNanos += now - throttleStart;
+    throttleEnd = 0;
+  }
+  quota = aQuota;
+  period = aPeriod;
+  periodStart = now;
+  used = 0;
+  if (quota) ++stats.periods;
+}
+
+void TaskGroup::Charge(uint64_t ran, uint64_t now) {
+  AssertCritical();
+  anarch::ScopedLock scope(lock);
+  stats.usedNanos += ran;
+  if (!quota) return;
+  Refill(now);
+  used += ran;
+  if (used >= quota && !throttleEnd) {
+    throttleStart = now;
+    throttleEnd = periodStart + period;
+    ++stats.throttledPeriods;
+  }
+}
+
+uint64_t TaskGroup::GetRemaining(uint64_t now) {
+  AssertCritical();
+  anarch::ScopedLock scope(lock);
+  if (!quota) return 0xffffffffffffffffUL;
+  Refill(now);
+  return used < quota ? quota - used : 0;
+}
+
+void TaskGroup::GetStats(TaskGroupStats & result) {
+  AssertCritical();
+  anarch::ScopedLock scope(lock);
+  result = stats;
+}
+
+void TaskGroup::ClearStats() {
+  AssertCritical();
+  anarch::ScopedLock scope(lock);
+  stats = TaskGroupStats();
+}
+
+void TaskGroup::Refill(uint64_t now) {
+  if (now < periodStart + period) return;
+  if (throttleEnd) {
+    stats.throttledNanos += throttleEnd - throttleStart;
+    throttleEnd = 0;
+  }
+  periodStart = now;
+  used = 0;
+  ++stats.periods;
+}
+
+}
@@ -0,0 +1,92 @@
+#ifndef __ALUX_TASK_GROUP_HPP__
+#define __ALUX_TASK_GROUP_HPP__
+
+#include <anarch/stdint>
+#include <anarch/lock>
+#include <ansa/atomic>
+
+namespace Alux {
+
+/**
+ * The counters of a task group, in the form that user space reads them.
+ */
+struct TaskGroupStats {
+  uint64_t periods = 0; // periods in which the group ran
+  uint64_t throttledPeriods = 0; // periods in which it ran out of quota
+  uint64_t throttledNanos = 0; // time its threads spent parked
+  uint64_t usedNanos = 0; // CPU time used by its threads
+};
+
+/**
+ * The CPU bandwidth limit shared by a group of tasks: together, their threads
+ * may run for [quota] ticks in every [period] ticks, on any number of CPUs.
+ * A group without a quota is never throttled.
+ *
+ * A period starts when the group first runs after the previous one ended, so
+ * an idle group does not pile up quota. Once the group has used its quota,
+ * [GetThrottleEnd] returns the time at which the next period begins.
+ */
+class TaskGroup {
+public:
+  TaskGroup() : throttleEnd(0) {} // @ambicritical
+  
+  /**
+   * Change the limit and start a new period.
+   * @critical
+   */
+  void SetLimit(uint64_t quota, uint64_t period, uint64_t now);
+  
+  /**
+   * Account for [ran] ticks that one of the group's threads just used.
+   * @critical
+   */
+  void Charge(uint64_t ran, uint64_t now);
+  
+  /**
+   * Return the number of ticks left in the current period, or 0 if the group
+   * is throttled. A group without a quota returns 0xffffffffffffffff.
+   * @critical
+   */
+  uint64_t GetRemaining(uint64_t now);
+  
+  /**
+   * Return the time at which the group's throttling ends, or 0 if it has not
+   * been throttled in this period. This may be called without any lock.
+   * @ambicritical
+   */
+  inline uint64_t GetThrottleEnd() {
+    return throttleEnd;
+  }
+  
+  /**
+   * Read the group's counters, with times still in ticks.
+   * @critical
+   */
+  void GetStats(TaskGroupStats &);
+  
+  /**
+   * Zero the group's counters.
+   * @critical
+   */
+  void ClearStats();
+  
+  // These are protected by the scheduler's lock for the list of groups.
+  bool inUse = false;
+  int taskCount = 0;
+  
+private:
+  anarch::CriticalLock lock;
+  uint64_t quota = 0;
+  uint64_t period = 0;
+  uint64_t periodStart = 0;
+  uint64_t used = 0;
+  uint64_t throttleStart = 0;
+  ansa::Atomic<uint64_t> throttleEnd;
+  TaskGroupStats stats;
+  
+  void Refill(uint64_t now);
+};
+
+}
+
+#endif
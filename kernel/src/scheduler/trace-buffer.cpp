@@ -0,0 +1,35 @@
+#include "trace-buffer.hpp"
+#include <anarch/critical>
+
+namespace Alux {
+
+TraceBuffer::TraceBuffer() : head(0), tail(0) {
+}
+
+void TraceBuffer::Write(const TraceEvent & event) {
+  AssertCritical();
+  uint64_t index = head;
+  if (index - tail == Capacity) {
+    ++dropped;
+    return;
+  }
+  events[index % Capacity] = event;
+  // the reader may only see the new head once the event is in place
+  head = index + 1;
+}
+
+int TraceBuffer::Read(TraceEvent * out, int max) {
+  AssertCritical();
+  uint64_t index = tail;
+  uint64_t end = head;
+  int count = 0;
+  while (index != end && count < max) {
+    out[count++] = events[index % Capacity];
+    ++index;
+  }
+  // the writer may only reuse the slots once they have been copied
+  tail = index;
+  return count;
+}
+
+}
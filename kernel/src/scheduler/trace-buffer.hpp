@@ -0,0 +1,81 @@
+#ifndef __ALUX_TRACE_BUFFER_HPP__
+#define __ALUX_TRACE_BUFFER_HPP__
+
+#include <anarch/stdint>
+#include <ansa/atomic>
+
+namespace Alux {
+
+/**
+ * One scheduling event, in the binary form that ReadTrace() hands to user
+ * space.
+ */
+struct TraceEvent {
+  enum Type {
+    TypeSwitchIn, // [thread] was switched to
+    TypeSwitchOut, // [thread] was switched away from
+    TypeWakeup, // [thread] became runnable
+    TypeTimeout, // [thread] armed a timeout and is about to yield
+    TypeIdle // the CPU ran out of threads; [thread] is 0
+  };
+  
+  uint64_t time; // global clock ticks
+  uint32_t task;
+  uint32_t thread;
+  uint32_t type;
+  uint32_t depth; // threads waiting in the recording CPU's run queue
+};
+
+/**
+ * Counters that a CPU keeps whether or not tracing is on.
+ */
+struct TraceStats {
+  uint64_t switches = 0; // threads switched to
+  uint64_t idles = 0; // times the CPU found nothing to run
+  uint64_t wakeups = 0; // threads made runnable on the CPU
+  uint64_t dropped = 0; // events lost because the CPU's buffer was full
+};
+
+/**
+ * A ring of [TraceEvent]s with a single writer and a single reader. The
+ * writer is the CPU that owns the buffer, from a critical section, so it
+ * never waits for anything; when the reader falls behind, new events are
+ * dropped rather than overwriting ones it has not seen.
+ */
+class TraceBuffer {
+public:
+  static const int Capacity = 1024;
+  
+  TraceBuffer(); // @ambicritical
+  
+  /**
+   * Append an event. Only the owning CPU may call this.
+   * @critical
+   */
+  void Write(const TraceEvent &);
+  
+  /**
+   * Move up to [max] of the oldest events into [out] and return how many
+   * were moved. Calls to this method must be serialized.
+   * @critical
+   */
+  int Read(TraceEvent * out, int max);
+  
+  /**
+   * Return the number of events that were dropped.
+   * @ambicritical
+   */
+  inline uint64_t GetDropped() {
+    return dropped;
+  }
+  
+private:
+  TraceEvent events[Capacity];
+  ansa::Atomic<uint64_t> head; // next event to write
+  ansa::Atomic<uint64_t> tail; // next event to read
+  uint64_t dropped = 0;
+};
+
+}
+
+#endif
@@ -0,0 +1,17 @@
+#include "work-item.hpp"
+#include <anarch/critical>
+
+namespace Alux {
+
+WorkItem::WorkItem(Function f, void * a, Priority p)
+  : link(*this), queued(false), function(f), argument(a), priority(p) {
+}
+
+void WorkItem::Run() {
+  AssertNoncritical();
+  // the function may free the object that we live in
+  queued = false;
+  function(argument);
+}
+
+}
@@ -0,0 +1,66 @@
+#ifndef __ALUX_WORK_ITEM_HPP__
+#define __ALUX_WORK_ITEM_HPP__
+
+#include <anarch/stdint>
+#include <ansa/linked-list>
+#include <ansa/atomic>
+
+namespace Alux {
+
+class WorkQueue;
+
+/**
+ * A piece of deferred work. A [WorkItem] is embedded in the object that needs
+ * the work done, so queueing it never allocates memory. An item may be queued
+ * again once its function has started running.
+ */
+class WorkItem {
+public:
+  typedef void (* Function)(void * argument);
+  
+  enum Priority {
+    PriorityUrgent, // runs before any bulk work that is waiting
+    PriorityBulk // frees and other work that nobody is waiting for
+  };
+  
+  /**
+   * Create an item which calls `function(argument)` from a noncritical
+   * worker thread.
+   * @ambicritical
+   */
+  WorkItem(Function function, void * argument,
+           Priority priority = PriorityUrgent);
+  
+  /**
+   * Returns `true` if the item is waiting in a queue.
+   * @ambicritical
+   */
+  inline bool IsQueued() {
+    return queued;
+  }
+  
+  /**
+   * @ambicritical
+   */
+  inline Priority GetPriority() {
+    return priority;
+  }
+  
+protected:
+  friend class WorkQueue;
+  
+  ansa::LinkedList<WorkItem>::Link link;
+  ansa::Atomic<bool> queued;
+  uint64_t deadline = 0; // for delayed items, the clock time to run at
+  
+  void Run(); // @noncritical
+  
+private:
+  Function function;
+  void * argument;
+  Priority priority;
+};
+
+}
+
+#endif
@@ -0,0 +1,291 @@
+#include "work-queue.hpp"
+#include "scheduler.hpp"
+#include <anarch/api/domain-list>
+#include <anarch/api/clock-module>
+#include <anarch/api/clock>
+#include <anarch/api/state>
+#include <anarch/api/panic>
+#include <anarch/critical>
+
+namespace Alux {
+
+namespace {
+
+uint64_t GetTicks() {
+  return anarch::ClockModule::GetGlobal().GetClock().GetTicks();
+}
+
+}
+
+WorkQueue::WorkQueue(Scheduler & s) : scheduler(s) {
+  anarch::DomainList & domains = anarch::DomainList::GetGlobal();
+  workerCount = 0;
+  for (int i = 0; i < domains.GetCount(); ++i) {
+    workerCount += domains[i].GetThreadCount();
+  }
+  workers = new Worker[workerCount];
+  assert(workers != NULL);
+  Worker * worker = workers;
+  for (int i = 0; i < domains.GetCount(); ++i) {
+    anarch::Domain & domain = domains[i];
+    for (int j = 0; j < domain.GetThreadCount(); ++j) {
+      worker->workQueue = this;
+      worker->cpu = &domain.GetThread(j);
+      worker->domain = &domain;
+      worker->pending = 0;
+      worker->bulkPending = 0;
+      worker->awake = false;
+      ++worker;
+    }
+  }
+}
+
+WorkQueue::~WorkQueue() {
+  delete[] workers;
+}
+
+void WorkQueue::Start(Task & task) {
+  AssertNoncritical();
+  for (int i = 0; i < workerCount; ++i) {
+    Worker & worker = workers[i];
+    anarch::State & state = anarch::State::NewKernel(RunWorker,
+                                                     (void *)&worker);
+    task.Retain();
+    Thread & thread = Thread::New(task, state);
+    if (!thread.AddToTask()) {
+      anarch::Panic("WorkQueue::Start() - failed to add thread to task");
+    }
+    thread.AddToScheduler();
+    
+    // keep the worker on the CPU whose items it runs, if the scheduler can
+    if (i < 64) {
+      scheduler.SetAffinity(thread, (uint64_t)1 << i);
+    }
+    
+    // an item may have been queued with no thread to wake
+    {
+      anarch::ScopedCritical critical;
+      anarch::ScopedLock scope(worker.wakeLock);
+      worker.thread = &thread;
+      worker.awake = true;
+      scheduler.ClearTimeout(thread);
+    }
+    thread.Release();
+  }
+}
+
+bool WorkQueue::Queue(WorkItem & item) {
+  if (!item.queued.CompareAndSwap(false, true)) return false;
+  anarch::ScopedCritical critical;
+  Worker & worker = GetCurrentWorker();
+  ++worker.pending;
+  if (item.priority == WorkItem::PriorityBulk) {
+    ++worker.bulkPending;
+  }
+  {
+    anarch::ScopedLock scope(worker.lock);
+    if (item.priority == WorkItem::PriorityBulk) {
+      worker.bulk.Add(&item.link);
+    } else {
+      worker.urgent.Add(&item.link);
+    }
+  }
+  if (worker.awake) {
+    if (worker.pending > BatchSize) WakeNeighbour(worker);
+  } else {
+    Wake(worker);
+  }
+  return true;
+}
+
+bool WorkQueue::QueueDelayed(WorkItem & item, uint64_t deadline) {
+  if (!item.queued.CompareAndSwap(false, true)) return false;
+  anarch::ScopedCritical critical;
+  Worker & worker = GetCurrentWorker();
+  item.deadline = deadline;
+  {
+    anarch::ScopedLock scope(worker.lock);
+    worker.delayed.Add(&item.link);
+    if (worker.nextDeadline && worker.nextDeadline <= deadline) {
+      return true;
+    }
+    worker.nextDeadline = deadline;
+  }
+  
+  // the worker may be asleep until a later deadline
+  Wake(worker);
+  return true;
+}
+
+void WorkQueue::ReduceBacklog() {
+  AssertNoncritical();
+  Worker * worker;
+  {
+    anarch::ScopedCritical critical;
+    worker = &GetCurrentWorker();
+  }
+  while (worker->bulkPending > MaxBulkPending) {
+    if (!RunBatch(*worker, true)) break;
+  }
+}
+
+int WorkQueue::GetPendingCount(WorkItem::Priority priority) {
+  int count = 0;
+  for (int i = 0; i < workerCount; ++i) {
+    if (priority == WorkItem::PriorityBulk) {
+      count += workers[i].bulkPending;
+    } else {
+      count += workers[i].pending - workers[i].bulkPending;
+    }
+  }
+  return count;
+}
+
+WorkQueue::Worker & WorkQueue::GetCurrentWorker() {
+  AssertCritical();
+  anarch::Thread & current = anarch::Thread::GetCurrent();
+  for (int i = 0; i < workerCount; ++i) {
+    if (workers[i].cpu == &current) return workers[i];
+  }
+  anarch::Panic("WorkQueue::GetCurrentWorker() - unknown CPU");
+}
+
+void WorkQueue::Wake(Worker & worker) {
+  AssertCritical();
+  // the worker counts new items before it sleeps if it is still awake
+  if (worker.awake) return;
+  anarch::ScopedLock scope(worker.wakeLock);
+  if (worker.awake) return;
+  worker.awake = true;
+  if (worker.thread) scheduler.ClearTimeout(*worker.thread);
+}
+
+void WorkQueue::WakeNeighbour(Worker & worker) {
+  AssertCritical();
+  int index = (int)(&worker - workers);
+  for (int i = 1; i < workerCount; ++i) {
+    Worker & other = workers[(index + i) % workerCount];
+    if (other.domain != worker.domain || other.awake) continue;
+    Wake(other);
+    return;
+  }
+}
+
+void WorkQueue::PromoteDelayed(Worker & worker) {
+  AssertCritical();
+  anarch::ScopedLock scope(worker.lock);
+  if (!worker.nextDeadline) return;
+  uint64_t now = GetTicks();
+  if (now < worker.nextDeadline) return;
+  
+  // go around the list once, moving every item which is due
+  int count = 0;
+  auto & list = worker.delayed;
+  for (auto i = list.GetStart(); i != list.GetEnd(); ++i) {
+    ++count;
+  }
+  worker.nextDeadline = 0;
+  for (int i = 0; i < count; ++i) {
+    WorkItem * item = worker.delayed.Shift();
+    if (item->deadline > now) {
+      worker.delayed.Add(&item->link);
+      if (!worker.nextDeadline || item->deadline < worker.nextDeadline) {
+        worker.nextDeadline = item->deadline;
+      }
+      continue;
+    }
+    ++worker.pending;
+    if (item->priority == WorkItem::PriorityBulk) {
+      ++worker.bulkPending;
+      worker.bulk.Add(&item->link);
+    } else {
+      worker.urgent.Add(&item->link);
+    }
+  }
+}
+
+bool WorkQueue::RunBatch(Worker & from, bool bulkOnly) {
+  AssertNoncritical();
+  WorkItem * batch[BatchSize];
+  int count = 0;
+  int bulkCount = 0;
+  {
+    anarch::ScopedCritical critical;
+    anarch::ScopedLock scope(from.lock);
+    while (!bulkOnly && count < BatchSize) {
+      WorkItem * item = from.urgent.Shift();
+      if (!item) break;
+      batch[count++] = item;
+    }
+    
+    // urgent items never wait behind a batch of bulk items
+    if (!count) {
+      while (count < BatchSize) {
+        WorkItem * item = from.bulk.Shift();
+        if (!item) break;
+        batch[count++] = item;
+      }
+      bulkCount = count;
+    }
+  }
+  from.pending -= count;
+  from.bulkPending -= bulkCount;
+  for (int i = 0; i < count; ++i) {
+    batch[i]->Run();
+  }
+  return count != 0;
+}
+
+bool WorkQueue::Steal(Worker & thief) {
+  AssertNoncritical();
+  // workers in other domains are only robbed once our own domain is idle
+  for (int pass = 0; pass < 2; ++pass) {
+    for (int i = 0; i < workerCount; ++i) {
+      Worker & victim = workers[i];
+      if (&victim == &thief || !victim.pending) continue;
+      if ((victim.domain == thief.domain) != (pass == 0)) continue;
+      if (RunBatch(victim, false)) return true;
+    }
+  }
+  return false;
+}
+
+void WorkQueue::Main(Worker & worker) {
+  AssertNoncritical();
+  while (1) {
+    {
+      anarch::ScopedCritical critical;
+      PromoteDelayed(worker);
+    }
+    if (RunBatch(worker, false)) continue;
+    if (Steal(worker)) continue;
+    
+    anarch::SetCritical(true);
+    worker.wakeLock.Seize();
+    worker.awake = false;
+    worker.lock.Seize();
+    uint64_t deadline = worker.nextDeadline;
+    worker.lock.Release();
+    if (worker.pending || (deadline && deadline <= GetTicks())) {
+      // an item was queued or came due after we looked
+      worker.awake = true;
+      worker.wakeLock.Release();
+    } else {
+      if (deadline) {
+        scheduler.SetTimeout(deadline, worker.wakeLock);
+      } else {
+        scheduler.SetInfiniteTimeout(worker.wakeLock);
+      }
+      // a timeout may have woken us rather than [Wake]
+      worker.awake = true;
+    }
+    anarch::SetCritical(false);
+  }
+}
+
+void WorkQueue::RunWorker(void * worker) {
+  Worker & w = *(Worker *)worker;
+  w.workQueue->Main(w);
+}
+
+}
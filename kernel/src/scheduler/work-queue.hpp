@@ -0,0 +1,113 @@
+#ifndef __ALUX_WORK_QUEUE_HPP__
+#define __ALUX_WORK_QUEUE_HPP__
+
+#include "work-item.hpp"
+#include <anarch/api/domain>
+#include <anarch/api/thread>
+#include <anarch/lock>
+
+namespace Alux {
+
+class Scheduler;
+class Task;
+class Thread;
+
+/**
+ * Runs [WorkItem]s from noncritical kernel threads, so that critical sections
+ * can hand off work that they are not allowed to do themselves.
+ *
+ * Every CPU has a worker thread with its own lists, and an item is queued on
+ * the CPU that queued it. A worker runs all of its urgent items before it
+ * takes a batch of [BatchSize] bulk items. A worker which runs out of work
+ * takes items from other workers, trying the ones in its own [anarch::Domain]
+ * first; when a busy worker has more than [BatchSize] items waiting, it wakes
+ * an idle neighbour to help.
+ *
+ * Delayed items wait on a separate list until their deadline. They are
+ * expected to be few, so the list is not sorted.
+ */
+class WorkQueue {
+public:
+  static const int BatchSize = 32;
+  static const int MaxBulkPending = 1024;
+  
+  WorkQueue(Scheduler &); // @noncritical
+  ~WorkQueue(); // @noncritical
+  
+  /**
+   * Create the worker threads in [task]. Items queued before this run once
+   * the threads do.
+   * @noncritical
+   */
+  void Start(Task & task);
+  
+  /**
+   * Queue an item on the current CPU. Returns `false` if it was already
+   * queued.
+   * @ambicritical
+   */
+  bool Queue(WorkItem &);
+  
+  /**
+   * Queue an item on the current CPU which will not run until the global
+   * clock reaches [deadline]. Returns `false` if it was already queued.
+   * @ambicritical
+   */
+  bool QueueDelayed(WorkItem &, uint64_t deadline);
+  
+  /**
+   * If the current CPU has more than [MaxBulkPending] bulk items waiting,
+   * run them on the calling thread until it does not.
+   * @noncritical
+   */
+  void ReduceBacklog();
+  
+  /**
+   * Return the number of items of a priority which are ready to run.
+   * @ambicritical
+   */
+  int GetPendingCount(WorkItem::Priority);
+  
+private:
+  struct Worker {
+    WorkQueue * workQueue = NULL;
+    anarch::Thread * cpu = NULL;
+    anarch::Domain * domain = NULL;
+    Thread * thread = NULL;
+    
+    // [lock] protects the lists and [nextDeadline]
+    anarch::CriticalLock lock;
+    ansa::LinkedList<WorkItem> urgent;
+    ansa::LinkedList<WorkItem> bulk;
+    ansa::LinkedList<WorkItem> delayed;
+    uint64_t nextDeadline = 0;
+    
+    // items in [urgent] and [bulk], counted right before they are added; an
+    // item is no longer counted once a worker has taken it
+    ansa::Atomic<int> pending;
+    ansa::Atomic<int> bulkPending;
+    
+    // [awake] is only set to `false` by the worker, with [wakeLock] held,
+    // right before it checks [pending] and [nextDeadline] and sleeps
+    anarch::CriticalLock wakeLock;
+    ansa::Atomic<bool> awake;
+  };
+  
+  Scheduler & scheduler;
+  Worker * workers;
+  int workerCount;
+  
+  Worker & GetCurrentWorker(); // @critical
+  void Wake(Worker &); // @critical
+  void WakeNeighbour(Worker &); // @critical
+  void PromoteDelayed(Worker &); // @critical
+  bool RunBatch(Worker & from, bool bulkOnly); // @noncritical
+  bool Steal(Worker &); // @noncritical
+  void Main(Worker &); // @noncritical
+  
+  static void RunWorker(void * worker);
+};
+
+}
+
+#endif
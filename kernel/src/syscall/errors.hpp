@@ -12,7 +12,18 @@ enum {
   SyscallErrorUnableToLaunch,
   SyscallErrorNoThread,
   SyscallErrorPortsListFull,
-  SyscallErrorNoPort
+  SyscallErrorNoPort,
+  SyscallErrorBadPriority,
+  SyscallErrorBadReservation,
+  SyscallErrorNotRunnable,
+  SyscallErrorBadAffinity,
+  SyscallErrorNoTrace,
+  SyscallErrorBadQuantum,
+  SyscallErrorNoTask,
+  SyscallErrorBadTaskGroup,
+  SyscallErrorBadVMOperation,
+  SyscallErrorNoSharedMemory,
+  SyscallErrorSharedMemoryFull
 };
 
 }
@@ -5,6 +5,7 @@
 #include "time.hpp"
 #include "task.hpp"
 #include "port.hpp"
+#include "trace.hpp"
 #include <anarch/stream>
 #include <anarch/critical>
 
@@ -82,6 +83,64 @@ anarch::SyscallRet SyscallHandler(uint16_t number,
       return CreatePortSyscall();
     case 28:
       return DestroyPortSyscall(args);
+    case 29:
+      return SetPrioritySyscall(args);
+    case 30:
+      return SetReservationSyscall(args);
+    case 31:
+      return YieldToSyscall(args);
+    case 32:
+      return SetAffinitySyscall(args);
+    case 33:
+      return SetTracingSyscall(args);
+    case 34:
+      return ReadTraceSyscall(args);
+    case 35:
+      return GetTraceStatsSyscall(args);
+    case 36:
+      return SetQuantumSyscall(args);
+    case 37:
+      return CreateTaskGroupSyscall(args);
+    case 38:
+      return SetTaskGroupLimitSyscall(args);
+    case 39:
+      return DestroyTaskGroupSyscall(args);
+    case 40:
+      return SetTaskGroupSyscall(args);
+    case 41:
+      return GetTaskGroupStatsSyscall(args);
+    case 42:
+      return GetObjectCacheStatsSyscall(args);
+    case 43:
+      return GetHeapStatsSyscall(args);
+    case 44:
+      return VMBatchSyscall(args);
+    case 45:
+      return CreateSharedMemorySyscall(args);
+    case 46:
+      return GrantSharedMemorySyscall(args);
+    case 47:
+      return MapSharedMemorySyscall(args);
+    case 48:
+      return UnmapSharedMemorySyscall(args);
+    case 49:
+      return CloseSharedMemorySyscall(args);
+    case 50:
+      return GetSharedMemorySizeSyscall(args);
+    case 51:
+      return VMAllocAnonymousSyscall(args);
+    case 52:
+      return VMFreeAnonymousSyscall(args);
+    case 53:
+      return VMProtectAnonymousSyscall(args);
+    case 54:
+      return VMDecommitAnonymousSyscall(args);
+    case 55:
+      return SetFaultAroundSyscall(args);
+    case 56:
+      return LaunchTaskSyscall(args);
+    case 57:
+      return SetRealtimeBoundSyscall(args);
     default:
       anarch::cerr << "unknown SyscallHandler(" << number << ", ...)"
         << anarch::endl;
@@ -1,8 +1,16 @@
 #include "memory.hpp"
 #include "errors.hpp"
 #include "../tasks/hold-scope.hpp"
+#include "../memory/object-cache.hpp"
+#include "../memory/heap.hpp"
+#include "../memory/zero-pool.hpp"
+#include "../memory/page-cache.hpp"
+#include "../memory/shared-memory.hpp"
+#include "../scheduler/scheduler.hpp"
+#include "../arch/all/executable-map.hpp"
 #include <anarch/api/user-map>
 #include <anarch/api/domain>
+#include <anarch/critical>
 
 using anarch::SyscallRet;
 using anarch::SyscallArgs;
@@ -27,6 +35,93 @@ anarch::MemoryMap::Attributes DecodeAttributes(int arg) {
   return result;
 }
 
+const int BatchChunkSize = 16;
+
+// returns the alignment of a page size, or 0 if it is not a page size
+size_t GetPageSizeAlign(uint64_t pageSize) {
+  for (int i = 0; i < anarch::UserMap::GetPageSizeCount(); ++i) {
+    if (anarch::UserMap::GetPageSize(i) == pageSize) {
+      return anarch::UserMap::GetPageSizeAlign(i);
+    }
+  }
+  return 0;
+}
+
+int ValidateOperation(const VMBatchEntry & entry) {
+  bool usesVirt = true;
+  bool usesPhys = false;
+  switch (entry.type) {
+    case 12: // VMMap
+      usesVirt = false;
+      usesPhys = true;
+      break;
+    case 13: // VMMapAt
+      usesPhys = true;
+      break;
+    case 16: // VMReserve
+      usesVirt = false;
+      break;
+    case 14:
+    case 15:
+    case 17:
+    case 18:
+    case 19:
+      break;
+    default:
+      return SyscallErrorBadVMOperation;
+  }
+  
+  size_t align = GetPageSizeAlign(entry.pageSize);
+  if (!align || !entry.pageCount) return SyscallErrorBadVMOperation;
+  if (usesVirt && entry.virtualAddr % align) {
+    return SyscallErrorBadVMOperation;
+  }
+  if (usesPhys && entry.physicalAddr % align) {
+    return SyscallErrorBadVMOperation;
+  }
+  if (entry.type == 19 && !GetPageSizeAlign(entry.newPageSize)) {
+    return SyscallErrorBadVMOperation;
+  }
+  return 0;
+}
+
+int ApplyOperation(anarch::UserMap & map, VMBatchEntry & entry) {
+  anarch::MemoryMap::Size size(entry.pageSize, entry.pageCount);
+  anarch::MemoryMap::Attributes attrs = DecodeAttributes(entry.attributes);
+  VirtAddr addr = entry.virtualAddr;
+  switch (entry.type) {
+    case 12:
+      if (!map.Map(addr, entry.physicalAddr, size, attrs)) {
+        return SyscallErrorNoVMSpace;
+      }
+      entry.virtualAddr = addr;
+      break;
+    case 13:
+      map.MapAt(addr, entry.physicalAddr, size, attrs);
+      break;
+    case 14:
+      map.Unmap(addr, size);
+      break;
+    case 15:
+      map.UnmapAndReserve(addr, size);
+      break;
+    case 16:
+      if (!map.Reserve(addr, size)) return SyscallErrorNoVMSpace;
+      entry.virtualAddr = addr;
+      break;
+    case 17:
+      map.ReserveAt(addr, size);
+      break;
+    case 18:
+      map.Unreserve(addr, size);
+      break;
+    case 19:
+      map.Rereserve(addr, size, entry.newPageSize);
+      break;
+  }
+  return 0;
+}
+
 }
 
 SyscallRet CountPageSizesSyscall() {
@@ -70,9 +165,17 @@ SyscallRet AllocateSyscall(SyscallArgs & args) {
   PhysSize align = args.PopPhysSize();
   
   PhysAddr result;
-  if (!anarch::Domain::GetCurrent().AllocPhys(result, size, align)) {
+  anarch::Domain & domain = anarch::Domain::GetCurrent();
+  if (size == PageCache::PageSize && align && !(size % align)) {
+    // single pages come cleared from the zero pool when it has any
+    bool zeroed;
+    if (!ZeroPool::Alloc(result, zeroed)) {
+      return SyscallRet::Error(SyscallErrorNoMemory);
+    }
+  } else if (!domain.AllocPhys(result, size, align)) {
     return SyscallRet::Error(SyscallErrorNoMemory);
   }
+  scope.GetTask().NoteMemoryDomain(domain);
   return SyscallRet::Phys(result);
 }
 
@@ -87,6 +190,51 @@ SyscallRet FreeSyscall(SyscallArgs & args) {
   return SyscallRet::Empty();
 }
 
+SyscallRet GetObjectCacheStatsSyscall(SyscallArgs & args) {
+  HoldScope scope;
+  if (scope.GetTask().GetUserIdentifier() != 0) {
+    return SyscallRet::Error(SyscallErrorPermissions);
+  }
+  
+  int kind = args.PopInt();
+  VirtAddr output = args.PopVirtAddr();
+  if (kind < 0 || kind >= ObjectCache::KindCount) {
+    return SyscallRet::Error(SyscallErrorIndex);
+  }
+  
+  ObjectCacheStats stats;
+  {
+    anarch::ScopedCritical critical;
+    ObjectCache::GetGlobal((ObjectCache::Kind)kind).GetStats(stats);
+  }
+  scope.GetUserTask().GetMemoryMap().CopyFromKernel(output, &stats,
+                                                    sizeof(stats));
+  return SyscallRet::Empty();
+}
+
+SyscallRet GetHeapStatsSyscall(SyscallArgs & args) {
+  HoldScope scope;
+  if (scope.GetTask().GetUserIdentifier() != 0) {
+    return SyscallRet::Error(SyscallErrorPermissions);
+  }
+  
+  int index = args.PopInt();
+  VirtAddr output = args.PopVirtAddr();
+  
+  ObjectCacheStats stats;
+  bool found;
+  {
+    anarch::ScopedCritical critical;
+    found = Heap::GetStats(index, stats);
+  }
+  if (!found) {
+    return SyscallRet::Error(SyscallErrorIndex);
+  }
+  scope.GetUserTask().GetMemoryMap().CopyFromKernel(output, &stats,
+                                                    sizeof(stats));
+  return SyscallRet::Empty();
+}
+
 SyscallRet VMReadSyscall(SyscallArgs & args) {
   HoldScope scope;
   if (scope.GetTask().GetUserIdentifier() != 0) {
@@ -245,4 +393,199 @@ SyscallRet VMRereserveSyscall(SyscallArgs & args) {
   return SyscallRet::Empty();
 }
 
+SyscallRet VMBatchSyscall(SyscallArgs & args) {
+  HoldScope scope;
+  if (scope.GetTask().GetUserIdentifier() != 0) {
+    return SyscallRet::Error(SyscallErrorPermissions);
+  }
+  
+  anarch::UserMap & map = scope.GetUserTask().GetMemoryMap();
+  VirtAddr entries = args.PopVirtAddr();
+  int count = args.PopInt();
+  if (count < 0) return SyscallRet::Error(SyscallErrorIndex);
+  
+  // entries are handled a chunk at a time; each chunk is validated before
+  // any of it is applied, and its results are copied back together
+  VMBatchEntry chunk[BatchChunkSize];
+  int succeeded = 0;
+  for (int done = 0; done < count; done += BatchChunkSize) {
+    int size = (count - done < BatchChunkSize ? count - done : BatchChunkSize);
+    VirtAddr addr = entries + (VirtAddr)done * sizeof(VMBatchEntry);
+    if (!map.CopyToKernel(chunk, addr, size * sizeof(VMBatchEntry))) {
+      // earlier chunks have already been applied, so their count stands
+      if (!done) return SyscallRet::Error(SyscallErrorNoMapping);
+      break;
+    }
+    for (int i = 0; i < size; ++i) {
+      chunk[i].result = ValidateOperation(chunk[i]);
+    }
+    for (int i = 0; i < size; ++i) {
+      if (chunk[i].result) continue;
+      chunk[i].result = ApplyOperation(map, chunk[i]);
+      if (!chunk[i].result) ++succeeded;
+    }
+    map.CopyFromKernel(addr, chunk, size * sizeof(VMBatchEntry));
+  }
+  return SyscallRet::Integer32((uint32_t)succeeded);
+}
+
+SyscallRet CreateSharedMemorySyscall(SyscallArgs & args) {
+  HoldScope scope;
+  size_t pageCount = args.PopVirtSize();
+  
+  SharedMemory * memory = SharedMemory::New(pageCount);
+  if (!memory) return SyscallRet::Error(SyscallErrorNoMemory);
+  int handle = scope.GetUserTask().GetSharedMemoryTable().Add(*memory);
+  memory->Release();
+  if (handle < 0) return SyscallRet::Error(SyscallErrorSharedMemoryFull);
+  return SyscallRet::Integer32((uint32_t)handle);
+}
+
+SyscallRet GrantSharedMemorySyscall(SyscallArgs & args) {
+  HoldScope scope;
+  int handle = args.PopInt();
+  uint32_t identifier = args.PopUInt32();
+  
+  SharedMemoryTable & table = scope.GetUserTask().GetSharedMemoryTable();
+  SharedMemory * memory = table.Get(handle);
+  if (!memory) return SyscallRet::Error(SyscallErrorNoSharedMemory);
+  
+  Scheduler & scheduler = scope.GetTask().GetScheduler();
+  Task * task = scheduler.GetTaskList().Find(identifier);
+  if (!task || !task->IsUserTask()) {
+    if (task) task->Release();
+    memory->Release();
+    return SyscallRet::Error(SyscallErrorNoTask);
+  }
+  
+  // only root may hand memory to another user's task
+  Identifier uid = scope.GetTask().GetUserIdentifier();
+  if (uid != 0 && task->GetUserIdentifier() != uid) {
+    task->Release();
+    memory->Release();
+    return SyscallRet::Error(SyscallErrorPermissions);
+  }
+  
+  UserTask & target = static_cast<UserTask &>(*task);
+  int result = target.GetSharedMemoryTable().Add(*memory);
+  task->Release();
+  memory->Release();
+  if (result < 0) return SyscallRet::Error(SyscallErrorSharedMemoryFull);
+  return SyscallRet::Integer32((uint32_t)result);
+}
+
+SyscallRet MapSharedMemorySyscall(SyscallArgs & args) {
+  HoldScope scope;
+  int handle = args.PopInt();
+  bool writable = args.PopBool();
+  
+  UserTask & task = scope.GetUserTask();
+  SharedMemory * memory = task.GetSharedMemoryTable().Get(handle);
+  if (!memory) return SyscallRet::Error(SyscallErrorNoSharedMemory);
+  memory->Release();
+  
+  VirtAddr result;
+  if (!task.GetSharedMemoryTable().Map(handle, task.GetMemoryMap(), writable,
+                                       result)) {
+    return SyscallRet::Error(SyscallErrorNoVMSpace);
+  }
+  return SyscallRet::Virt(result);
+}
+
+SyscallRet UnmapSharedMemorySyscall(SyscallArgs & args) {
+  HoldScope scope;
+  int handle = args.PopInt();
+  
+  UserTask & task = scope.GetUserTask();
+  if (!task.GetSharedMemoryTable().Unmap(handle, task.GetMemoryMap())) {
+    return SyscallRet::Error(SyscallErrorNoSharedMemory);
+  }
+  return SyscallRet::Empty();
+}
+
+SyscallRet CloseSharedMemorySyscall(SyscallArgs & args) {
+  HoldScope scope;
+  int handle = args.PopInt();
+  
+  UserTask & task = scope.GetUserTask();
+  if (!task.GetSharedMemoryTable().Remove(handle, task.GetMemoryMap())) {
+    return SyscallRet::Error(SyscallErrorNoSharedMemory);
+  }
+  return SyscallRet::Empty();
+}
+
+SyscallRet GetSharedMemorySizeSyscall(SyscallArgs & args) {
+  HoldScope scope;
+  int handle = args.PopInt();
+  
+  SharedMemoryTable & table = scope.GetUserTask().GetSharedMemoryTable();
+  SharedMemory * memory = table.Get(handle);
+  if (!memory) return SyscallRet::Error(SyscallErrorNoSharedMemory);
+  size_t size = memory->GetPageCount() * SharedMemory::PageSize;
+  memory->Release();
+  return SyscallRet::VirtSize(size);
+}
+
+SyscallRet VMAllocAnonymousSyscall(SyscallArgs & args) {
+  HoldScope scope;
+  size_t pageCount = args.PopVirtSize();
+  int encodedAttributes = args.PopInt();
+  
+  anarch::MemoryMap::Attributes attrs = DecodeAttributes(encodedAttributes);
+  VirtAddr result;
+  if (!scope.GetUserTask().GetAnonymousMap().Create(result, pageCount,
+                                                    attrs)) {
+    return SyscallRet::Error(SyscallErrorNoVMSpace);
+  }
+  return SyscallRet::Virt(result);
+}
+
+SyscallRet VMFreeAnonymousSyscall(SyscallArgs & args) {
+  HoldScope scope;
+  VirtAddr start = args.PopVirtAddr();
+  if (!scope.GetUserTask().GetAnonymousMap().Destroy(start)) {
+    return SyscallRet::Error(SyscallErrorNoMapping);
+  }
+  return SyscallRet::Empty();
+}
+
+SyscallRet VMProtectAnonymousSyscall(SyscallArgs & args) {
+  HoldScope scope;
+  VirtAddr start = args.PopVirtAddr();
+  size_t pageCount = args.PopVirtSize();
+  int encodedAttributes = args.PopInt();
+  
+  anarch::MemoryMap::Attributes attrs = DecodeAttributes(encodedAttributes);
+  AnonymousMap & map = scope.GetUserTask().GetAnonymousMap();
+  if (!map.Protect(start, pageCount, attrs)) {
+    return SyscallRet::Error(SyscallErrorNoMapping);
+  }
+  return SyscallRet::Empty();
+}
+
+SyscallRet VMDecommitAnonymousSyscall(SyscallArgs & args) {
+  HoldScope scope;
+  VirtAddr start = args.PopVirtAddr();
+  size_t pageCount = args.PopVirtSize();
+  
+  AnonymousMap & map = scope.GetUserTask().GetAnonymousMap();
+  if (!map.Decommit(start, pageCount)) {
+    return SyscallRet::Error(SyscallErrorNoMapping);
+  }
+  return SyscallRet::Empty();
+}
+
+SyscallRet SetFaultAroundSyscall(SyscallArgs & args) {
+  HoldScope scope;
+  if (scope.GetTask().GetUserIdentifier() != 0) {
+    return SyscallRet::Error(SyscallErrorPermissions);
+  }
+  
+  int pages = args.PopInt();
+  if (!ExecutableMap::SetFaultAroundPages(pages)) {
+    return SyscallRet::Error(SyscallErrorIndex);
+  }
+  return SyscallRet::Empty();
+}
+
 }
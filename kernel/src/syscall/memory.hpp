@@ -2,6 +2,7 @@
 #define __ALUX_SYSCALL_MEMORY_HPP__
 
 #include <anarch/types>
+#include <anarch/stdint>
 #include <anarch/api/syscall-ret>
 #include <anarch/api/syscall-args>
 
@@ -17,6 +18,10 @@ anarch::SyscallRet GetVMCapabilitiesSyscall();
 anarch::SyscallRet AllocateSyscall(anarch::SyscallArgs &);
 anarch::SyscallRet FreeSyscall(anarch::SyscallArgs &);
 
+// kernel object caches
+anarch::SyscallRet GetObjectCacheStatsSyscall(anarch::SyscallArgs &);
+anarch::SyscallRet GetHeapStatsSyscall(anarch::SyscallArgs &);
+
 anarch::SyscallRet VMReadSyscall(anarch::SyscallArgs &);
 anarch::SyscallRet VMMapSyscall(anarch::SyscallArgs &);
 anarch::SyscallRet VMMapAtSyscall(anarch::SyscallArgs &);
@@ -27,6 +32,45 @@ anarch::SyscallRet VMReserveAtSyscall(anarch::SyscallArgs &);
 anarch::SyscallRet VMUnreserveSyscall(anarch::SyscallArgs &);
 anarch::SyscallRet VMRereserveSyscall(anarch::SyscallArgs &);
 
+/**
+ * One operation of [VMBatchSyscall], as laid out in user space. [type] is the
+ * number of the syscall which performs the operation on its own, from 12
+ * (VMMap) to 19 (VMRereserve), and the other fields are that syscall's
+ * arguments. VMMap and VMReserve write the address they chose back into
+ * [virtualAddr]. [result] is set to 0 or to the operation's error code.
+ * The syscall returns how many operations succeeded; if part of the array
+ * cannot be read, it stops there, after the operations before it.
+ */
+struct VMBatchEntry {
+  uint32_t type;
+  int32_t attributes;
+  uint64_t virtualAddr;
+  uint64_t physicalAddr;
+  uint64_t pageSize;
+  uint64_t pageCount;
+  uint64_t newPageSize;
+  int64_t result;
+};
+
+anarch::SyscallRet VMBatchSyscall(anarch::SyscallArgs &);
+
+// shared memory, usable by any task
+anarch::SyscallRet CreateSharedMemorySyscall(anarch::SyscallArgs &);
+anarch::SyscallRet GrantSharedMemorySyscall(anarch::SyscallArgs &);
+anarch::SyscallRet MapSharedMemorySyscall(anarch::SyscallArgs &);
+anarch::SyscallRet UnmapSharedMemorySyscall(anarch::SyscallArgs &);
+anarch::SyscallRet CloseSharedMemorySyscall(anarch::SyscallArgs &);
+anarch::SyscallRet GetSharedMemorySizeSyscall(anarch::SyscallArgs &);
+
+// demand-zero memory, usable by any task
+anarch::SyscallRet VMAllocAnonymousSyscall(anarch::SyscallArgs &);
+anarch::SyscallRet VMFreeAnonymousSyscall(anarch::SyscallArgs &);
+anarch::SyscallRet VMProtectAnonymousSyscall(anarch::SyscallArgs &);
+anarch::SyscallRet VMDecommitAnonymousSyscall(anarch::SyscallArgs &);
+
+// executable maps
+anarch::SyscallRet SetFaultAroundSyscall(anarch::SyscallArgs &);
+
 }
 
 #endif
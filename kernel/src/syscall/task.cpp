@@ -1,5 +1,10 @@
 #include "task.hpp"
+#include "errors.hpp"
 #include "../tasks/hold-scope.hpp"
+#include "../tasks/user-task.hpp"
+#include "../scheduler/scheduler.hpp"
+#include <anarch/api/user-map>
+#include <anarch/api/state>
 #include <anarch/critical>
 
 namespace Alux {
@@ -22,4 +27,149 @@ anarch::SyscallRet GetUidSyscall() {
   return anarch::SyscallRet::Integer32((uint32_t)t.GetUserIdentifier());
 }
 
+anarch::SyscallRet LaunchTaskSyscall(anarch::SyscallArgs & args) {
+  HoldScope scope;
+  uint32_t identifier = args.PopUInt32();
+  
+  Scheduler & scheduler = scope.GetTask().GetScheduler();
+  Task * source = scheduler.GetTaskList().Find(identifier);
+  if (!source) {
+    return anarch::SyscallRet::Error(SyscallErrorNoTask);
+  }
+  if (!source->IsUserTask()) {
+    source->Release();
+    return anarch::SyscallRet::Error(SyscallErrorNoTask);
+  }
+  Identifier uid = scope.GetTask().GetUserIdentifier();
+  if (uid != 0 && source->GetUserIdentifier() != uid) {
+    source->Release();
+    return anarch::SyscallRet::Error(SyscallErrorPermissions);
+  }
+  
+  // executables are never freed, so it outlives the task we found it in
+  UserTask & sourceTask = static_cast<UserTask &>(*source);
+  Executable & executable = sourceTask.GetExecutableMap().GetExecutable();
+  source->Release();
+  
+  anarch::UserMap & map = anarch::UserMap::New();
+  UserTask & task = UserTask::New(executable, map, uid, scheduler);
+  if (!task.AddToScheduler()) {
+    task.Dealloc();
+    return anarch::SyscallRet::Error(SyscallErrorUnableToLaunch);
+  }
+  
+  // the new task shares its launcher's quota, so a limited task cannot get
+  // out from under its group by launching copies of itself
+  int group = scope.GetTask().GetTaskGroup();
+  if (group && !scheduler.SetTaskGroup(task, group)) {
+    task.Kill(Task::KillReasonAbort);
+    task.Unhold();
+    return anarch::SyscallRet::Error(SyscallErrorUnableToLaunch);
+  }
+  
+  // create the first thread (which consumes a reference to the task)
+  void * entry = task.GetExecutableMap().GetEntryPoint();
+  anarch::State & state = anarch::State::NewUser((void (*)())entry);
+  task.Retain();
+  Thread & thread = Thread::New(task, state);
+  if (!thread.AddToTask()) {
+    thread.Release();
+    thread.Dealloc();
+    task.Kill(Task::KillReasonAbort);
+    task.Unhold();
+    return anarch::SyscallRet::Error(SyscallErrorUnableToLaunch);
+  }
+  thread.AddToScheduler();
+  
+  uint32_t result = (uint32_t)task.GetIdentifier();
+  thread.Release();
+  task.Unhold();
+  return anarch::SyscallRet::Integer32(result);
+}
+
+anarch::SyscallRet CreateTaskGroupSyscall(anarch::SyscallArgs & args) {
+  HoldScope scope;
+  if (scope.GetTask().GetUserIdentifier() != 0) {
+    return anarch::SyscallRet::Error(SyscallErrorPermissions);
+  }
+  
+  uint64_t quota = args.PopUInt64();
+  uint64_t period = args.PopUInt64();
+  Scheduler & scheduler = scope.GetTask().GetScheduler();
+  int group = scheduler.CreateTaskGroup(quota, period);
+  if (group < 0) {
+    return anarch::SyscallRet::Error(SyscallErrorBadTaskGroup);
+  }
+  return anarch::SyscallRet::Integer32((uint32_t)group);
+}
+
+anarch::SyscallRet SetTaskGroupLimitSyscall(anarch::SyscallArgs & args) {
+  HoldScope scope;
+  if (scope.GetTask().GetUserIdentifier() != 0) {
+    return anarch::SyscallRet::Error(SyscallErrorPermissions);
+  }
+  
+  int group = args.PopInt();
+  uint64_t quota = args.PopUInt64();
+  uint64_t period = args.PopUInt64();
+  Scheduler & scheduler = scope.GetTask().GetScheduler();
+  if (!scheduler.SetTaskGroupLimit(group, quota, period)) {
+    return anarch::SyscallRet::Error(SyscallErrorBadTaskGroup);
+  }
+  return anarch::SyscallRet::Empty();
+}
+
+anarch::SyscallRet DestroyTaskGroupSyscall(anarch::SyscallArgs & args) {
+  HoldScope scope;
+  if (scope.GetTask().GetUserIdentifier() != 0) {
+    return anarch::SyscallRet::Error(SyscallErrorPermissions);
+  }
+  
+  int group = args.PopInt();
+  if (!scope.GetTask().GetScheduler().DestroyTaskGroup(group)) {
+    return anarch::SyscallRet::Error(SyscallErrorBadTaskGroup);
+  }
+  return anarch::SyscallRet::Empty();
+}
+
+anarch::SyscallRet SetTaskGroupSyscall(anarch::SyscallArgs & args) {
+  HoldScope scope;
+  if (scope.GetTask().GetUserIdentifier() != 0) {
+    return anarch::SyscallRet::Error(SyscallErrorPermissions);
+  }
+  
+  uint32_t identifier = args.PopUInt32();
+  int group = args.PopInt();
+  Scheduler & scheduler = scope.GetTask().GetScheduler();
+  Task * task = scheduler.GetTaskList().Find(identifier);
+  if (!task) {
+    return anarch::SyscallRet::Error(SyscallErrorNoTask);
+  }
+  
+  bool result = scheduler.SetTaskGroup(*task, group);
+  task->Release();
+  if (!result) {
+    return anarch::SyscallRet::Error(SyscallErrorBadTaskGroup);
+  }
+  return anarch::SyscallRet::Empty();
+}
+
+anarch::SyscallRet GetTaskGroupStatsSyscall(anarch::SyscallArgs & args) {
+  HoldScope scope;
+  if (scope.GetTask().GetUserIdentifier() != 0) {
+    return anarch::SyscallRet::Error(SyscallErrorPermissions);
+  }
+  
+  int group = args.PopInt();
+  VirtAddr output = args.PopVirtAddr();
+  
+  TaskGroupStats stats;
+  if (!scope.GetTask().GetScheduler().GetTaskGroupStats(group, stats)) {
+    return anarch::SyscallRet::Error(SyscallErrorBadTaskGroup);
+  }
+  scope.GetUserTask().GetMemoryMap().CopyFromKernel(output, &stats,
+                                                    sizeof(stats));
+  return anarch::SyscallRet::Empty();
+}
+
 }
@@ -9,6 +9,12 @@ namespace Alux {
 void ExitSyscall(anarch::SyscallArgs & args);
 anarch::SyscallRet GetPidSyscall();
 anarch::SyscallRet GetUidSyscall();
+anarch::SyscallRet LaunchTaskSyscall(anarch::SyscallArgs & args);
+anarch::SyscallRet CreateTaskGroupSyscall(anarch::SyscallArgs & args);
+anarch::SyscallRet SetTaskGroupLimitSyscall(anarch::SyscallArgs & args);
+anarch::SyscallRet DestroyTaskGroupSyscall(anarch::SyscallArgs & args);
+anarch::SyscallRet SetTaskGroupSyscall(anarch::SyscallArgs & args);
+anarch::SyscallRet GetTaskGroupStatsSyscall(anarch::SyscallArgs & args);
 
 }
 
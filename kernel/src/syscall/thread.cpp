@@ -3,6 +3,7 @@
 #include "../threads/sleep-state.hpp"
 #include "../threads/thread.hpp"
 #include "../tasks/hold-scope.hpp"
+#include "../scheduler/scheduler.hpp"
 
 namespace Alux {
 
@@ -61,4 +62,122 @@ anarch::SyscallRet WakeupSyscall(anarch::SyscallArgs & args) {
   return anarch::SyscallRet::Empty();
 }
 
-}
\ No newline at end of file
+anarch::SyscallRet YieldToSyscall(anarch::SyscallArgs & args) {
+  HoldScope scope;
+  uint32_t identifier = args.PopUInt32();
+  
+  Thread * th = scope.GetTask().GetThreadList().Find(identifier);
+  if (!th) {
+    return anarch::SyscallRet::Error(SyscallErrorNoThread);
+  }
+  
+  bool result = scope.GetTask().GetScheduler().YieldTo(*th);
+  th->Release();
+  if (!result) {
+    return anarch::SyscallRet::Error(SyscallErrorNotRunnable);
+  }
+  return anarch::SyscallRet::Empty();
+}
+
+anarch::SyscallRet SetPrioritySyscall(anarch::SyscallArgs & args) {
+  HoldScope scope;
+  uint32_t identifier = args.PopUInt32();
+  int priority = args.PopInt();
+  
+  // only root may put a thread ahead of the default priority
+  Scheduler & scheduler = scope.GetTask().GetScheduler();
+  if (priority < scheduler.GetDefaultPriority() &&
+      scope.GetTask().GetUserIdentifier() != 0) {
+    return anarch::SyscallRet::Error(SyscallErrorPermissions);
+  }
+  
+  Thread * th = scope.GetTask().GetThreadList().Find(identifier);
+  if (!th) {
+    return anarch::SyscallRet::Error(SyscallErrorNoThread);
+  }
+  
+  bool result = scheduler.SetPriority(*th, priority);
+  th->Release();
+  if (!result) {
+    return anarch::SyscallRet::Error(SyscallErrorBadPriority);
+  }
+  return anarch::SyscallRet::Empty();
+}
+
+anarch::SyscallRet SetReservationSyscall(anarch::SyscallArgs & args) {
+  HoldScope scope;
+  if (scope.GetTask().GetUserIdentifier() != 0) {
+    return anarch::SyscallRet::Error(SyscallErrorPermissions);
+  }
+  
+  uint32_t identifier = args.PopUInt32();
+  uint64_t runtime = args.PopUInt64();
+  uint64_t period = args.PopUInt64();
+  uint64_t deadline = args.PopUInt64();
+  
+  Thread * th = scope.GetTask().GetThreadList().Find(identifier);
+  if (!th) {
+    return anarch::SyscallRet::Error(SyscallErrorNoThread);
+  }
+  
+  Scheduler & scheduler = scope.GetTask().GetScheduler();
+  bool result = scheduler.SetReservation(*th, runtime, period, deadline);
+  th->Release();
+  if (!result) {
+    return anarch::SyscallRet::Error(SyscallErrorBadReservation);
+  }
+  return anarch::SyscallRet::Empty();
+}
+
+anarch::SyscallRet SetRealtimeBoundSyscall(anarch::SyscallArgs & args) {
+  HoldScope scope;
+  if (scope.GetTask().GetUserIdentifier() != 0) {
+    return anarch::SyscallRet::Error(SyscallErrorPermissions);
+  }
+  
+  uint32_t bound = args.PopUInt32();
+  if (!scope.GetTask().GetScheduler().SetRealtimeBound(bound)) {
+    return anarch::SyscallRet::Error(SyscallErrorBadReservation);
+  }
+  return anarch::SyscallRet::Empty();
+}
+
+anarch::SyscallRet SetAffinitySyscall(anarch::SyscallArgs & args) {
+  HoldScope scope;
+  uint32_t identifier = args.PopUInt32();
+  uint64_t mask = args.PopUInt64();
+  
+  Thread * th = scope.GetTask().GetThreadList().Find(identifier);
+  if (!th) {
+    return anarch::SyscallRet::Error(SyscallErrorNoThread);
+  }
+  
+  Scheduler & scheduler = scope.GetTask().GetScheduler();
+  bool result = scheduler.SetAffinity(*th, mask);
+  th->Release();
+  if (!result) {
+    return anarch::SyscallRet::Error(SyscallErrorBadAffinity);
+  }
+  return anarch::SyscallRet::Empty();
+}
+
+anarch::SyscallRet SetQuantumSyscall(anarch::SyscallArgs & args) {
+  HoldScope scope;
+  uint32_t identifier = args.PopUInt32();
+  uint64_t quantum = args.PopUInt64();
+  
+  Thread * th = scope.GetTask().GetThreadList().Find(identifier);
+  if (!th) {
+    return anarch::SyscallRet::Error(SyscallErrorNoThread);
+  }
+  
+  Scheduler & scheduler = scope.GetTask().GetScheduler();
+  bool result = scheduler.SetQuantum(*th, quantum);
+  th->Release();
+  if (!result) {
+    return anarch::SyscallRet::Error(SyscallErrorBadQuantum);
+  }
+  return anarch::SyscallRet::Empty();
+}
+
+}
@@ -12,6 +12,12 @@ anarch::SyscallRet LaunchThreadSyscall(anarch::SyscallArgs &);
 void SleepSyscall(anarch::SyscallArgs &);
 void SleepInfiniteSyscall();
 anarch::SyscallRet WakeupSyscall(anarch::SyscallArgs &);
+anarch::SyscallRet YieldToSyscall(anarch::SyscallArgs &);
+anarch::SyscallRet SetPrioritySyscall(anarch::SyscallArgs &);
+anarch::SyscallRet SetReservationSyscall(anarch::SyscallArgs &);
+anarch::SyscallRet SetRealtimeBoundSyscall(anarch::SyscallArgs &);
+anarch::SyscallRet SetAffinitySyscall(anarch::SyscallArgs &);
+anarch::SyscallRet SetQuantumSyscall(anarch::SyscallArgs &);
 
 }
 
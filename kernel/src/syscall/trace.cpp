@@ -0,0 +1,82 @@
+#include "trace.hpp"
+#include "errors.hpp"
+#include "../tasks/hold-scope.hpp"
+#include "../tasks/user-task.hpp"
+#include "../scheduler/scheduler.hpp"
+
+using anarch::SyscallRet;
+using anarch::SyscallArgs;
+
+namespace Alux {
+
+namespace {
+
+const int ChunkSize = 32;
+
+}
+
+SyscallRet SetTracingSyscall(SyscallArgs & args) {
+  HoldScope scope;
+  if (scope.GetTask().GetUserIdentifier() != 0) {
+    return SyscallRet::Error(SyscallErrorPermissions);
+  }
+  
+  bool enabled = args.PopBool();
+  if (!scope.GetTask().GetScheduler().SetTracing(enabled)) {
+    return SyscallRet::Error(SyscallErrorNoTrace);
+  }
+  return SyscallRet::Empty();
+}
+
+SyscallRet ReadTraceSyscall(SyscallArgs & args) {
+  HoldScope scope;
+  if (scope.GetTask().GetUserIdentifier() != 0) {
+    return SyscallRet::Error(SyscallErrorPermissions);
+  }
+  
+  int cpu = args.PopInt();
+  VirtAddr buffer = args.PopVirtAddr();
+  int max = args.PopInt();
+  
+  // events are drained a chunk at a time so that no lock is held while they
+  // are copied to the task
+  Scheduler & scheduler = scope.GetTask().GetScheduler();
+  anarch::UserMap & map = scope.GetUserTask().GetMemoryMap();
+  TraceEvent events[ChunkSize];
+  int total = 0;
+  while (total < max) {
+    int chunk = (max - total < ChunkSize ? max - total : ChunkSize);
+    int count = scheduler.ReadTrace(cpu, events, chunk);
+    if (count < 0) {
+      return SyscallRet::Error(SyscallErrorNoTrace);
+    }
+    if (!count) break;
+    VirtAddr dest = buffer + (VirtAddr)total * sizeof(TraceEvent);
+    if (!map.CopyFromKernel(dest, events, count * sizeof(TraceEvent))) {
+      return SyscallRet::Error(SyscallErrorNoMapping);
+    }
+    total += count;
+    if (count < chunk) break;
+  }
+  return SyscallRet::Integer32((uint32_t)total);
+}
+
+SyscallRet GetTraceStatsSyscall(SyscallArgs & args) {
+  HoldScope scope;
+  if (scope.GetTask().GetUserIdentifier() != 0) {
+    return SyscallRet::Error(SyscallErrorPermissions);
+  }
+  
+  int cpu = args.PopInt();
+  VirtAddr output = args.PopVirtAddr();
+  
+  TraceStats stats;
+  if (!scope.GetTask().GetScheduler().GetTraceStats(cpu, stats)) {
+    return SyscallRet::Error(SyscallErrorNoTrace);
+  }
+  scope.GetUserTask().GetMemoryMap().CopyFromKernel(output, &stats,
+                                                    sizeof(stats));
+  return SyscallRet::Empty();
+}
+
+}
@@ -0,0 +1,15 @@
+#ifndef __ALUX_SYSCALL_TRACE_HPP__
+#define __ALUX_SYSCALL_TRACE_HPP__
+
+#include <anarch/api/syscall-ret>
+#include <anarch/api/syscall-args>
+
+namespace Alux {
+
+anarch::SyscallRet SetTracingSyscall(anarch::SyscallArgs &);
+anarch::SyscallRet ReadTraceSyscall(anarch::SyscallArgs &);
+anarch::SyscallRet GetTraceStatsSyscall(anarch::SyscallArgs &);
+
+}
+
+#endif
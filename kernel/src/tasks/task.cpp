@@ -1,12 +1,23 @@
 // no need to include "thread.hpp" or "task.hpp" ourselves
 #include "../scheduler/scheduler.hpp"
+#include "../memory/object-cache.hpp"
 #include <anarch/critical>
 
 namespace Alux {
 
 Task::Task(Identifier user, Scheduler & sched)
   : GarbageObject(sched.GetGarbageCollector()), hashMapLink(*this),
-    uid(user), scheduler(sched) { 
+    schedulerThreadCount(0), schedulerGroup(0), uid(user),
+    scheduler(sched) {
+}
+
+void * Task::operator new(size_t size) {
+  ObjectCache & cache = ObjectCache::GetGlobal(ObjectCache::KindTask);
+  return cache.Alloc(size);
+}
+
+void Task::operator delete(void * ptr, size_t size) {
+  ObjectCache::Release(ptr, size);
 }
 
 bool Task::AddToScheduler() {
@@ -76,6 +87,11 @@ void Task::Dealloc() {
   if (inScheduler) {
     scheduler.GetTaskList().Remove(*this);
   }
+  
+  // leave the task group so that it can be destroyed
+  if (schedulerGroup) {
+    scheduler.SetTaskGroup(*this, 0);
+  }
 }
 
 }
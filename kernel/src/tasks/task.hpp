@@ -6,7 +6,10 @@
 #include "../containers/thread-list.hpp"
 #include <anidmap/id-object>
 #include <anarch/api/memory-map>
+#include <anarch/api/domain>
 #include <anarch/assert>
+#include <ansa/atomic>
+#include <ansa/atomic-ptr>
 
 namespace Alux {
 
@@ -48,6 +51,14 @@ public:
   virtual ~Task() {
   }
   
+  /**
+   * Every kind of task is allocated from the global [ObjectCache] for
+   * tasks.
+   * @noncritical
+   */
+  static void * operator new(size_t);
+  static void operator delete(void *, size_t);
+  
   /**
    * The task was terminated by its own volition.
    */
@@ -149,6 +160,15 @@ public:
     return uid;
   }
   
+  /**
+   * Get the index of the scheduler's task group that this task belongs to,
+   * or 0 if it is in no group.
+   * @ambicritical
+   */
+  inline int GetTaskGroup() {
+    return schedulerGroup;
+  }
+  
   /**
    * Get the list of threads belonging to this task. The task should be added
    * to the scheduler before you attempt to call this method.
@@ -159,6 +179,24 @@ public:
     return threadList;
   }
   
+  /**
+   * Returns the domain that the task's memory was first allocated from, or
+   * NULL if the task has not allocated any memory yet.
+   * @ambicritical
+   */
+  inline anarch::Domain * GetMemoryDomain() {
+    return memoryDomain;
+  }
+  
+  /**
+   * Record that some of the task's memory was allocated from [domain]. Only
+   * the first such domain is remembered, so the task's home does not change.
+   * @ambicritical
+   */
+  inline void NoteMemoryDomain(anarch::Domain & domain) {
+    if (!memoryDomain) memoryDomain = &domain;
+  }
+  
   /**
    * Remove the task from its scheduler's task list. This does not actually
    * delete the task--that is up to the subclass.
@@ -175,11 +213,25 @@ protected:
    */
   ansa::LinkedList<Task>::Link hashMapLink;
   
+  /**
+   * The number of this task's threads that its scheduler is managing. The
+   * scheduler may use this to share the CPU fairly between tasks.
+   */
+  friend class Scheduler;
+  ansa::Atomic<int> schedulerThreadCount;
+  
+  /**
+   * The index of the scheduler's task group that this task belongs to, or 0
+   * if it is in no group.
+   */
+  ansa::Atomic<int> schedulerGroup;
+  
 private:
   Identifier uid;
   Scheduler & scheduler;
   ThreadList threadList;
   bool inScheduler = false;
+  ansa::AtomicPtr<anarch::Domain> memoryDomain;
   
   // [lifeLock] applies to [retainCount], [holdCount], [killReason], and 
   // [killed].
@@ -26,7 +26,8 @@ void UserTask::Dealloc() {
 
 UserTask::UserTask(Executable & e, anarch::UserMap & m, Identifier i, 
                    Scheduler & s)
-  : Task(i, s), memoryMap(m), executableMap(e.GenerateMap(m)) {
+  : Task(i, s), memoryMap(m), executableMap(e.GenerateMap(m)),
+    anonymousMap(m) {
 }
 
 UserTask::~UserTask() {
@@ -3,6 +3,8 @@
 
 #include "task.hpp"
 #include "../arch/all/executable.hpp"
+#include "../memory/shared-memory.hpp"
+#include "../memory/anonymous-map.hpp"
 
 namespace Alux {
 
@@ -27,6 +29,22 @@ public:
     return executableMap;
   }
   
+  /**
+   * Returns the task's demand-zero regions.
+   * @ambicritical
+   */
+  inline AnonymousMap & GetAnonymousMap() {
+    return anonymousMap;
+  }
+  
+  /**
+   * Returns the task's shared memory handles.
+   * @ambicritical
+   */
+  inline SharedMemoryTable & GetSharedMemoryTable() {
+    return sharedMemory;
+  }
+  
   /**
    * Returns the task's memory map.
    * @ambicritical
@@ -51,6 +69,10 @@ private:
   
   anarch::UserMap & memoryMap;
   ExecutableMap & executableMap;
+  
+  // destroyed after the destructor has deleted [memoryMap]
+  SharedMemoryTable sharedMemory;
+  AnonymousMap anonymousMap;
 };
 
 }
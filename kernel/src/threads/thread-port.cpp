@@ -1,4 +1,5 @@
 #include "../scheduler/scheduler.hpp" // no need for "thread-port.hpp"
+#include "../memory/object-cache.hpp"
 
 namespace Alux {
 
@@ -8,6 +9,15 @@ ThreadPort & ThreadPort::New(Thread & t) {
   return *res;
 }
 
+void * ThreadPort::operator new(size_t size) {
+  ObjectCache & cache = ObjectCache::GetGlobal(ObjectCache::KindThreadPort);
+  return cache.Alloc(size);
+}
+
+void ThreadPort::operator delete(void * ptr, size_t size) {
+  ObjectCache::Release(ptr, size);
+}
+
 bool ThreadPort::AddToThread() {
   return thread.GetPortList().Add(*this);
 }
@@ -19,6 +19,13 @@ public:
    */
   static ThreadPort & New(Thread &);
   
+  /**
+   * Ports are allocated from their global [ObjectCache].
+   * @noncritical
+   */
+  static void * operator new(size_t);
+  static void operator delete(void *, size_t);
+  
   /**
    * Attempt to add this port to its thread. If the thread has no available
    * port identifiers, this will fail and return `false`.
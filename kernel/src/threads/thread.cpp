@@ -1,21 +1,33 @@
 // no need to include "thread.hpp" or "task.hpp" ourselves
 #include "../scheduler/scheduler.hpp"
+#include "../memory/object-cache.hpp"
 #include <anarch/api/thread>
 #include <anarch/critical>
 
 namespace Alux {
-  
+
 Thread::~Thread() {
   state.Delete();
 }
 
 Thread & Thread::New(Task & t, anarch::State & s) {
   AssertNoncritical();
+  // a storm of dying threads must not be outrun by new ones
+  t.GetScheduler().GetGarbageCollector().ReduceBacklog();
   Thread * result = new Thread(t, s);
   assert(result != NULL);
   return *result;
 }
 
+void * Thread::operator new(size_t size) {
+  ObjectCache & cache = ObjectCache::GetGlobal(ObjectCache::KindThread);
+  return cache.Alloc(size);
+}
+
+void Thread::operator delete(void * ptr, size_t size) {
+  ObjectCache::Release(ptr, size);
+}
+
 Thread * Thread::GetCurrent() {
   anarch::ScopedCritical critical;
   return (Thread *)anarch::Thread::GetUserInfo();
@@ -44,6 +44,13 @@ public:
    */
   static Thread & New(Task &, anarch::State &);
   
+  /**
+   * Threads are allocated from their global [ObjectCache].
+   * @noncritical
+   */
+  static void * operator new(size_t);
+  static void operator delete(void *, size_t);
+  
   /**
    * Get the current thread by reading this hardware thread's user-info.
    * @ambicritical
@@ -153,7 +160,7 @@ private:
   anarch::State & state;
   
   ThreadPortList portList;
-    
+  
   // [lifeLock] controls both [retainCount] and [killed].
   anarch::CriticalLock lifeLock;
   int retainCount = 1;